@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "ActivityMap.h"
+#include "MixKernels.h"
+#include "Profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace WavAudio {
+
+namespace {
+
+constexpr uint32_t kActivityMagic = 0x31504D41;	// "AMP1"
+
+} // namespace
+
+ActivityMap::ActivityMap()
+	: m_numActive{ 0 }
+	, m_numRecorded{ 0 }
+	, m_header{}
+	, m_recording{ false }
+{}
+
+bool ActivityMap::load(const char* sourcePath, uint64_t numBlocks, uint32_t blockSize, uint32_t sampleRate, float threshold)
+{
+	TIMER_SCOPED("load activity map");
+	ASSERT(blockSize > 0);
+
+	m_active.assign(static_cast<size_t>(numBlocks), 0);
+	m_numActive = 0;
+	m_numRecorded = 0;
+	m_recording = true;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.m_magic = kActivityMagic;
+	m_header.m_blockSize = blockSize;
+	m_header.m_sampleRate = sampleRate;
+	m_header.m_threshold = threshold;
+	m_header.m_numBlocks = numBlocks;
+
+	m_mapPath.clear();
+	if (!get_file_stamp(sourcePath, m_header.m_source))
+	{
+		// nothing to key a saved map on, record and keep it for this run only.
+		return false;
+	}
+	m_mapPath = std::string(sourcePath) + ".activity";
+
+	std::ifstream mapFile(m_mapPath, std::ios::binary);
+	Header saved;
+	if (!mapFile.read(reinterpret_cast<char*>(&saved), sizeof(saved)) || memcmp(&saved, &m_header, sizeof(saved)) != 0)
+	{
+		return false;
+	}
+	if (numBlocks > 0 && !mapFile.read(reinterpret_cast<char*>(m_active.data()), m_active.size()))
+	{
+		std::fill(m_active.begin(), m_active.end(), uint8_t(0));
+		return false;
+	}
+
+	m_numActive = static_cast<uint64_t>(std::count(m_active.begin(), m_active.end(), uint8_t(1)));
+	m_recording = false;
+	return true;
+}
+
+void ActivityMap::record(uint64_t block, const float* samples, uint32_t count)
+{
+	ASSERT(m_recording);
+	if (block >= m_active.size())
+	{
+		// the mix runs past the end of a shorter input.
+		return;
+	}
+	ASSERT(block == m_numRecorded);
+
+	if (Mixer::g_mixKernels.m_peak(samples, count) > m_header.m_threshold)
+	{
+		m_active[static_cast<size_t>(block)] = 1;
+		++m_numActive;
+	}
+	++m_numRecorded;
+}
+
+void ActivityMap::save()
+{
+	if (!m_recording || m_numRecorded != m_active.size() || m_mapPath.empty())
+	{
+		return;
+	}
+
+	// written under a temporary name, a map cut short never looks finished.
+	const std::string tempPath = m_mapPath + ".tmp";
+	{
+		std::ofstream mapFile(tempPath, std::ios::binary | std::ios::trunc);
+		mapFile.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+		mapFile.write(reinterpret_cast<const char*>(m_active.data()), m_active.size());
+		if (!mapFile)
+		{
+			return;
+		}
+	}
+	std::remove(m_mapPath.c_str());
+	std::rename(tempPath.c_str(), m_mapPath.c_str());
+	m_recording = false;
+}
+
+} // namespace WavAudio
@@ -0,0 +1,66 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+namespace WavAudio {
+
+// Which blocks of an input have any sample above a silence threshold.
+// Blocks are the mixer's blocks at the output rate, so they line up whether the input is
+// resampled or not. The mixer and the prefetchers step past silent blocks instead of
+// decoding and mixing them.
+// The map is kept in a file next to the input, keyed by the input's size and write time.
+// When there is none for the input yet, the mix reads every block as usual and records
+// each block's peak as it goes, so finding the silence never costs a pass of its own.
+class ActivityMap
+{
+public:
+	ActivityMap();
+
+	// Loads the map saved for sourcePath, numBlocks blocks of blockSize samples at sampleRate.
+	// Returns false if there is none for this version of the file and these settings,
+	// the map is then recording. A threshold of 0 only treats digital silence as silent.
+	bool load(const char* sourcePath, uint64_t numBlocks, uint32_t blockSize, uint32_t sampleRate, float threshold);
+
+	// While recording every block must be read and passed to record, nothing is skipped.
+	bool is_recording() const { return m_recording; }
+
+	// Marks block from its decoded samples, blocks are recorded in order.
+	void record(uint64_t block, const float* samples, uint32_t count);
+
+	// Writes a recorded map once every block has been seen, a partial one is dropped.
+	// A failed write only means the next run records again.
+	void save();
+
+	// Blocks past the end of the input are silent.
+	bool is_active(uint64_t block) const { return block < m_active.size() && m_active[block] != 0; }
+
+	uint64_t get_num_blocks() const { return m_active.size(); }
+	uint64_t get_active_blocks() const { return m_numActive; }
+
+private:
+	// Everything the map depends on, written in front of the flags.
+	struct Header
+	{
+		uint32_t m_magic;
+		uint32_t m_blockSize;
+		uint32_t m_sampleRate;
+		float m_threshold;
+		uint64_t m_numBlocks;
+		FileStamp m_source;
+	};
+
+	std::vector<uint8_t> m_active;	// a flag per block
+	uint64_t m_numActive;
+	uint64_t m_numRecorded;	// blocks seen so far while recording
+	std::string m_mapPath;
+	Header m_header;
+	bool m_recording;
+};
+
+} // namespace WavAudio
@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "AlignedArena.h"
+#include <cstdlib>
+#include <new>
+
+#if defined _WIN32
+	#include <malloc.h>
+#endif
+
+void* aligned_malloc(size_t bytes, size_t alignment)
+{
+#if defined _WIN32
+	void* memory = _aligned_malloc(bytes, alignment);
+#else
+	void* memory = nullptr;
+	if (posix_memalign(&memory, alignment, bytes) != 0)
+	{
+		memory = nullptr;
+	}
+#endif
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void aligned_free(void* memory)
+{
+#if defined _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+AlignedArena::AlignedArena()
+	: m_memory{ nullptr }
+	, m_capacity{ 0 }
+	, m_used{ 0 }
+{}
+
+AlignedArena::~AlignedArena()
+{
+	aligned_free(m_memory);
+}
+
+void AlignedArena::init(size_t capacity)
+{
+	aligned_free(m_memory);
+	m_memory = nullptr;
+
+	m_capacity = aligned_size(capacity);
+	m_used = 0;
+	if (m_capacity > 0)
+	{
+		m_memory = static_cast<uint8_t*>(aligned_malloc(m_capacity, kArenaAlignment));
+	}
+}
+
+void* AlignedArena::allocate(size_t bytes)
+{
+	const size_t size = aligned_size(bytes);
+	ASSERT(m_used + size <= m_capacity);
+
+	void* memory = m_memory + m_used;
+	m_used += size;
+	return memory;
+}
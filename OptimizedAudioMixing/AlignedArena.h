@@ -0,0 +1,48 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <cstddef>
+
+// Cache line and widest vector register size, every arena allocation starts on this boundary.
+constexpr size_t kArenaAlignment = 64;
+
+void* aligned_malloc(size_t bytes, size_t alignment);
+void aligned_free(void* memory);
+
+// One aligned heap block that is carved up with a bump pointer.
+// Sized once up front and reused, so nothing is allocated while mixing.
+class AlignedArena
+{
+public:
+	AlignedArena();
+	~AlignedArena();
+
+	AlignedArena(const AlignedArena&) = delete;
+	AlignedArena& operator = (const AlignedArena&) = delete;
+
+	// Frees any previous block and allocates capacity bytes.
+	void init(size_t capacity);
+
+	// Returns bytes of kArenaAlignment aligned memory, the arena must have room for it.
+	void* allocate(size_t bytes);
+
+	template<typename T>
+	T* allocate_array(size_t count) { return static_cast<T*>(allocate(count * sizeof(T))); }
+
+	// Releases every allocation but keeps the memory.
+	void reset() { m_used = 0; }
+
+	size_t get_capacity() const { return m_capacity; }
+	size_t get_used() const { return m_used; }
+
+	// Space an allocation of bytes takes up in the arena, for sizing init().
+	static size_t aligned_size(size_t bytes) { return (bytes + kArenaAlignment - 1) & ~(kArenaAlignment - 1); }
+
+private:
+	uint8_t* m_memory;
+	size_t m_capacity;
+	size_t m_used;
+};
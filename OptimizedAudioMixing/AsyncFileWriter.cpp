@@ -0,0 +1,157 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "AsyncFileWriter.h"
+#include "Profiler.h"
+
+constexpr uint32_t kNoBatch = ~0u;
+
+AsyncFileWriter::AsyncFileWriter()
+	: m_stream{ nullptr }
+	, m_currentBatch{ kNoBatch }
+	, m_writing{ false }
+	, m_stopRequested{ false }
+	, m_stallCount{ 0 }
+{}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	stop();
+}
+
+void AsyncFileWriter::start(std::ostream& stream, uint32_t batchBytes, uint32_t numBatches)
+{
+	ASSERT(batchBytes > 0 && numBatches > 0);
+	stop();
+
+	m_stream = &stream;
+	m_batches.resize(numBatches);
+	m_freeBatches.clear();
+	m_queuedBatches.clear();
+	for (uint32_t i = 0; i < numBatches; ++i)
+	{
+		m_batches[i].m_data.resize(batchBytes);
+		m_batches[i].m_used = 0;
+		m_freeBatches.push_back(numBatches - 1 - i);
+	}
+
+	// producer starts with a batch in hand.
+	m_currentBatch = m_freeBatches.back();
+	m_freeBatches.pop_back();
+
+	m_writing = false;
+	m_stopRequested = false;
+	m_stallCount = 0;
+
+	m_thread = std::thread(&AsyncFileWriter::writer_thread, this);
+}
+
+void AsyncFileWriter::stop()
+{
+	if (!m_thread.joinable())
+	{
+		return;
+	}
+
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopRequested = true;
+	}
+	m_batchQueued.notify_one();
+	m_thread.join();
+	m_stream = nullptr;
+}
+
+uint8_t* AsyncFileWriter::reserve(uint32_t bytes)
+{
+	ASSERT(is_running());
+
+	Batch* batch = &m_batches[m_currentBatch];
+	if (batch->m_used + bytes > batch->m_data.size() && batch->m_used > 0)
+	{
+		submit_current_batch();
+		batch = &m_batches[m_currentBatch];
+	}
+
+	if (bytes > batch->m_data.size())
+	{
+		batch->m_data.resize(bytes);
+	}
+
+	return &batch->m_data[batch->m_used];
+}
+
+void AsyncFileWriter::commit(uint32_t bytes)
+{
+	Batch& batch = m_batches[m_currentBatch];
+	ASSERT(batch.m_used + bytes <= batch.m_data.size());
+	batch.m_used += bytes;
+}
+
+void AsyncFileWriter::flush()
+{
+	if (!is_running())
+	{
+		return;
+	}
+
+	if (m_batches[m_currentBatch].m_used > 0)
+	{
+		submit_current_batch();
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_batchWritten.wait(lock, [this]() { return m_queuedBatches.empty() && !m_writing; });
+}
+
+void AsyncFileWriter::submit_current_batch()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queuedBatches.push_back(m_currentBatch);
+	m_batchQueued.notify_one();
+
+	// take the next free batch, waiting on the writer if the disk is behind.
+	if (m_freeBatches.empty())
+	{
+		++m_stallCount;
+		m_batchWritten.wait(lock, [this]() { return !m_freeBatches.empty(); });
+	}
+	m_currentBatch = m_freeBatches.back();
+	m_freeBatches.pop_back();
+}
+
+void AsyncFileWriter::writer_thread()
+{
+	TIMER_THREAD_NAME("write behind");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_batchQueued.wait(lock, [this]() { return m_stopRequested || !m_queuedBatches.empty(); });
+		if (m_queuedBatches.empty())
+		{
+			// stop requested and nothing left to write.
+			return;
+		}
+
+		const uint32_t index = m_queuedBatches.front();
+		m_queuedBatches.pop_front();
+		m_writing = true;
+
+		// one large write per batch, outside the lock.
+		lock.unlock();
+		Batch& batch = m_batches[index];
+		{
+			TIMER_SCOPED("write batch");
+			m_stream->write(reinterpret_cast<const char*>(batch.m_data.data()), batch.m_used);
+		}
+		batch.m_used = 0;
+		lock.lock();
+
+		m_writing = false;
+		m_freeBatches.push_back(index);
+		m_batchWritten.notify_all();
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Write behind queue for an output stream.
+// The producer encodes straight into large batch buffers, full batches are written
+// by a background thread so disk latency never lands on the producer.
+// Batches are recycled, the producer only waits when every batch is queued for writing.
+//
+//		uint8_t* dst = writer.reserve(bytes);
+//		... encode bytes into dst ...
+//		writer.commit(bytes);
+class AsyncFileWriter
+{
+public:
+	AsyncFileWriter();
+	~AsyncFileWriter();
+
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter& operator = (const AsyncFileWriter&) = delete;
+
+	// Starts the writer thread. Nobody else may touch stream until stop().
+	void start(std::ostream& stream, uint32_t batchBytes, uint32_t numBatches);
+
+	// Writes everything still queued and joins the writer thread.
+	void stop();
+
+	bool is_running() const { return m_thread.joinable(); }
+
+	// Space for bytes in the current batch, submitting it first if it is too full.
+	// A reservation bigger than a batch grows that batch to fit.
+	uint8_t* reserve(uint32_t bytes);
+
+	// Marks bytes of the last reservation as written.
+	void commit(uint32_t bytes);
+
+	// Submits the current batch and waits until everything committed so far is written.
+	void flush();
+
+	// Number of times reserve() had to wait for a free batch.
+	uint32_t get_stall_count() const { return m_stallCount; }
+
+private:
+	struct Batch
+	{
+		std::vector<uint8_t> m_data;
+		uint32_t m_used;
+	};
+
+	void submit_current_batch();
+	void writer_thread();
+
+	std::ostream* m_stream;
+	std::vector<Batch> m_batches;
+
+	std::mutex m_mutex;
+	std::condition_variable m_batchQueued;		// producer -> writer
+	std::condition_variable m_batchWritten;		// writer -> producer
+	std::deque<uint32_t> m_queuedBatches;		// full batches, oldest first
+	std::vector<uint32_t> m_freeBatches;		// empty batches ready for the producer
+	uint32_t m_currentBatch;					// batch the producer is filling, owned by the producer
+	bool m_writing;								// writer thread is busy outside the lock
+	bool m_stopRequested;
+	uint32_t m_stallCount;						// producer side only
+
+	std::thread m_thread;
+};
@@ -5,33 +5,107 @@
 #include "Config.h"
 #include "WaveFile.h"
 #include "Profiler.h"
+#include "CpuFeatures.h"
+#include "MixKernels.h"
+#include "PcmCodecs.h"
+#include "Benchmark.h"
+#include "Prefetcher.h"
+#include "MixerContext.h"
+#include "ParallelRender.h"
+#include "StreamParallelMixer.h"
+#include "RealtimeMixer.h"
+#include "BlockPump.h"
+#include "ChannelMixer.h"
+#include "GainEnvelope.h"
+#include "RemixCache.h"
+#include "ActivityMap.h"
 #include <iostream>
-#include <immintrin.h>
-#include <zmmintrin.h>
+#include <thread>
 
 constexpr uint32_t kNumAudioStreams = 4;
 constexpr uint32_t kTestBlockSize = 4096; // samples, e.g. 2048 stereo samples.
 constexpr uint32_t kNumBlocks = 3698; // total number of blocks to mix, input files must be long enough.
+constexpr uint32_t kOutputSampleRate = 48000; // inputs at any other rate are resampled to this, float path only.
+const WavAudio::eAudioFormat kOutputFormat = WavAudio::eAudioFormat::kFormat_16bitPCM; // 24/32bit PCM or float for the float path.
+constexpr uint32_t kPrefetchDepth = 4; // blocks each input reads ahead of the mixer.
+constexpr uint32_t kWriteBatchBytes = 2 * 1024 * 1024; // output is written to disk in batches this big.
+constexpr uint32_t kWriteBatches = 3; // batches in flight, the mixer waits if all are queued.
+constexpr uint32_t kRenderThreads = 0; // parallel render workers, 0 uses every hardware thread.
+constexpr uint32_t kStreamsPerGroup = 2; // streams each pool task mixes before the tree reduction.
+constexpr uint32_t kKernelTimerSampleEvery = 64; // fine profiling times one kernel call in this many.
+constexpr uint32_t kMixWorkers = 0; // pool threads besides the mixer thread, 0 uses every hardware thread.
+constexpr uint32_t kRealtimeFrames = 256; // stereo frames the simulated device asks for per callback.
+constexpr uint32_t kRealtimeRingFrames = 8192; // frames queued per source ring and in the output ring.
+constexpr double kRealtimeSpeedup = 8.0; // simulated clock runs this much faster than real time.
+constexpr uint64_t kRegionStartFrame = 60 * kOutputSampleRate; // REGION_RERENDER patches 10 seconds from here.
+constexpr uint64_t kRegionEndFrame = kRegionStartFrame + 10 * kOutputSampleRate;
+constexpr float kSilenceThreshold = 0.0f; // SILENCE_SKIPPING skips blocks peaking at or below this, 0 keeps the mix bit exact.
+const char* const kRemixCacheDir = "."; // where REMIX_CACHE keeps its group sums, must exist.
+
+const Mixer::eChannelLayout kMixOutputLayout = Mixer::eChannelLayout::kStereo; // output speaker layout for CHANNEL_MATRIX_MIXING.
 
 constexpr int kInSize = sizeof(WavAudio::WavAudioFileInput);
 constexpr float kInCacheLines = kInSize / 16;
 
 //////////////////////////////////////////////////////////////////////////
-#define INT_16BIT_MIXING 0
-#define USING_FMADD_INTRIN 1
-
-#define USING_256_BIT_REGS 1
-#define USING_512_BIT_REGS 0
+#define INT_16BIT_MIXING 0	// mix the 16 bit samples in Q15 fixed point without converting to float
+#define FUSED_STREAM_MIXING 1	// mix all streams in one pass with mix_streams or mix_streams16
+#define RUN_KERNEL_BENCHMARKS 0	// run the kernel microbenchmarks instead of mixing files
+#define RUN_BENCHMARK_SUITE 0	// run the full kernel and I/O benchmark sweep instead of mixing files
+#define MAPPED_INPUT_FILES 1	// memory map the inputs instead of streaming them through std::ifstream
+#define PREFETCH_INPUT_FILES 1	// read and decode inputs ahead on background threads, float path only
+#define WRITE_BEHIND_OUTPUT 1	// write the output in large batches on a background thread
+#define PARALLEL_OFFLINE_RENDER 0	// split the timeline into chunks and mix them on every core
+#define STREAM_PARALLEL_MIXING 0	// mix stream groups on a thread pool and tree reduce them, fused path only
+#define REALTIME_PUMP_MIXING 0	// drive the mix from a simulated audio device callback through lock free rings
+#define CHANNEL_MATRIX_MIXING 0	// mix through planar buffers and a gain matrix per stream into kMixOutputLayout, float path only
+#define GAIN_AUTOMATION 0	// ramp the gains along g_gainEnvelopes instead of holding g_gainFactors, fused float path only
+#define REGION_RERENDER 0	// after the mix, render kRegionStartFrame to kRegionEndFrame again over the finished output
+#define REMIX_CACHE 0	// render from a tree of cached sums of kStreamsPerGroup streams, only sums whose sources or gains changed are mixed
+#define SILENCE_SKIPPING 0	// skip decoding and mixing silent input blocks, mapped while an input is first mixed, fused float path only
 //////////////////////////////////////////////////////////////////////////
 
-#define ALIGN16 __declspec(align(16))
-#define ALIGN32 __declspec(align(32))
-#define ALIGN64 __declspec(align(64))
+#if INT_16BIT_MIXING == 1
+	// the prefetchers decode to float.
+	#undef PREFETCH_INPUT_FILES
+	#define PREFETCH_INPUT_FILES 0
+#endif
+
+#if INT_16BIT_MIXING == 1 && PREFETCH_INPUT_FILES == 1
+	#error "The 16 bit path reads the inputs itself, the prefetchers would race it for the same files."
+#endif
+
+#if INT_16BIT_MIXING == 1 || FUSED_STREAM_MIXING == 0 || CHANNEL_MATRIX_MIXING == 1 || GAIN_AUTOMATION == 1 || STREAM_PARALLEL_MIXING == 1
+	// the other paths mix every stream of every block.
+	#undef SILENCE_SKIPPING
+	#define SILENCE_SKIPPING 0
+#endif
 
 // Define our audio streams.
 ALIGN16 WavAudio::WavAudioFileInput g_inputFiles[kNumAudioStreams];
 ALIGN16 WavAudio::WavAudioFileOutput g_outputFile;
 
+#if PREFETCH_INPUT_FILES == 1
+WavAudio::WavAudioPrefetcher g_inputPrefetchers[kNumAudioStreams];
+#endif
+
+// Aligned block buffers and file scratch memory, sized once in prepare_audio_files.
+Mixer::MixerContext g_mixerContext;
+
+#if STREAM_PARALLEL_MIXING == 1
+WorkStealingPool g_mixPool;
+Mixer::StreamParallelMixer g_streamMixer;
+#endif
+
+#if CHANNEL_MATRIX_MIXING == 1
+Mixer::ChannelMixer g_channelMixer;
+#endif
+
+#if SILENCE_SKIPPING == 1
+WavAudio::ActivityMap g_activityMaps[kNumAudioStreams];
+uint64_t g_mixBlock = 0;	// index of the block being mixed
+#endif
+
 // Define some paths to files we want to load.
 const char* const g_inputFilePaths[kNumAudioStreams] = {
 	"audio_input_1.wav",
@@ -53,6 +127,33 @@ float g_gainFactors[kNumAudioStreams * 2] =
 	 0.3f, 0.7f
 };
 
+// g_gainFactors in Q15 for the 16 bit path, filled in main.
+int16_t g_gainFactorsQ15[kNumAudioStreams * 2];
+
+#if GAIN_AUTOMATION == 1
+// A Left/Right envelope per stream and the frame the next block starts on.
+Mixer::GainEnvelope g_gainEnvelopes[kNumAudioStreams * 2];
+uint64_t g_mixFrame = 0;
+
+// Fades each g_gainFactors gain in over half a second, then dips it 12dB and back
+// with exponential ramps across the middle third of the mix.
+void init_gain_envelopes()
+{
+	const uint64_t totalFrames = static_cast<uint64_t>(kNumBlocks) * kTestBlockSize / 2;
+	for (uint32_t i = 0; i < kNumAudioStreams * 2; ++i)
+	{
+		const float gain = g_gainFactors[i];
+		Mixer::GainEnvelope& envelope = g_gainEnvelopes[i];
+		envelope.reset(gain);
+		envelope.add_point(0, 0.0f);
+		envelope.add_point(kOutputSampleRate / 2, gain);
+		envelope.add_point(totalFrames / 3, gain);
+		envelope.add_point(totalFrames / 2, gain * 0.25f, Mixer::eRampShape::kExponential);
+		envelope.add_point(totalFrames * 2 / 3, gain, Mixer::eRampShape::kExponential);
+	}
+}
+#endif
+
 // OPens audio files for reading and writing.
 void prepare_audio_files()
 {
@@ -60,165 +161,456 @@ void prepare_audio_files()
 	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
 	{
 		std::cout << "Open input file " << g_inputFilePaths[i] << std::endl;
+#if MAPPED_INPUT_FILES == 1
+		g_inputFiles[i].open(g_inputFilePaths[i], WavAudio::eInputMode::kMapped);
+#else
 		g_inputFiles[i].open(g_inputFilePaths[i]);
+#endif
 		g_inputFiles[i].print_format_info(std::cout);
+#if INT_16BIT_MIXING == 0
+		g_inputFiles[i].enable_resampling(kOutputSampleRate, kTestBlockSize);
+#else
+		// the 16 bit reads do not resample.
+		ASSERT(g_inputFiles[i].get_format().m_samplesPerSec == kOutputSampleRate);
+#endif
 	}
 
 	std::cout << "Open output file " << g_outputFilePath << std::endl;
-	WavAudio::FmtChunk format = WavAudio::make_format(WavAudio::eAudioFormat::kFormat_16bitPCM, 2, 48000);
+#if CHANNEL_MATRIX_MIXING == 1
+	const uint16_t outChannels = static_cast<uint16_t>(Mixer::get_layout_channels(kMixOutputLayout));
+#else
+	const uint16_t outChannels = 2;
+#endif
+	WavAudio::FmtChunk format = WavAudio::make_format(kOutputFormat, outChannels, kOutputSampleRate);
 	g_outputFile.open(g_outputFilePath, format);
 	g_outputFile.print_format_info(std::cout);
+
+	// Size every block buffer and each file's scratch memory once, from one aligned arena.
+	uint32_t maxBytesPerSample = format.m_bitsPerSample / 8;
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		maxBytesPerSample = std::max<uint32_t>(maxBytesPerSample, g_inputFiles[i].get_format().m_bitsPerSample / 8);
+	}
+	// a stereo block upmixed to more channels encodes more samples than it read.
+	const uint32_t scratchBytes = kTestBlockSize / 2 * std::max<uint32_t>(outChannels, 2) * maxBytesPerSample;
+	g_mixerContext.init(kTestBlockSize, kNumAudioStreams, kNumAudioStreams + 1, scratchBytes);
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		g_inputFiles[i].set_scratch_memory(g_mixerContext.get_scratch(i), scratchBytes);
+	}
+	g_outputFile.set_scratch_memory(g_mixerContext.get_scratch(kNumAudioStreams), scratchBytes);
+
+#if SILENCE_SKIPPING == 1
+	// inputs without a saved map are mixed in full this time and mapped on the way.
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		// only the blocks the mix reaches are mapped, or a map could never be finished.
+		const uint64_t numBlocks = std::min<uint64_t>((g_inputFiles[i].samples_remaining() + kTestBlockSize - 1) / kTestBlockSize, kNumBlocks);
+		if (g_activityMaps[i].load(g_inputFilePaths[i], numBlocks, kTestBlockSize, kOutputSampleRate, kSilenceThreshold))
+		{
+			std::cout << "Active blocks " << g_inputFilePaths[i] << ": " << g_activityMaps[i].get_active_blocks() << " of " << g_activityMaps[i].get_num_blocks() << std::endl;
+		}
+		else
+		{
+			std::cout << "Mapping silence " << g_inputFilePaths[i] << ": " << numBlocks << " blocks" << std::endl;
+		}
+	}
+#endif
+
+#if PREFETCH_INPUT_FILES == 1
+	// from here on only the prefetchers read the inputs, mapped float inputs have nothing to decode ahead.
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		if (g_inputFiles[i].data_float() == nullptr)
+		{
+#if SILENCE_SKIPPING == 1
+			g_inputPrefetchers[i].start(g_inputFiles[i], kTestBlockSize, kPrefetchDepth, g_activityMaps[i].is_recording() ? nullptr : &g_activityMaps[i]);
+#else
+			g_inputPrefetchers[i].start(g_inputFiles[i], kTestBlockSize, kPrefetchDepth);
+#endif
+		}
+	}
+#endif
+
+#if WRITE_BEHIND_OUTPUT == 1
+	g_outputFile.enable_write_behind(kWriteBatchBytes, kWriteBatches);
+#endif
+
+#if STREAM_PARALLEL_MIXING == 1
+	g_mixPool.start(kMixWorkers);
+	g_streamMixer.init(g_mixPool, kNumAudioStreams, kStreamsPerGroup, kTestBlockSize);
+#endif
+
+#if CHANNEL_MATRIX_MIXING == 1
+	// Blocks are sized in samples of the stereo inputs, each stream's Left/Right gains
+	// scale the columns of the standard stereo to kMixOutputLayout matrix.
+	uint32_t streamChannels[kNumAudioStreams];
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		streamChannels[i] = g_inputFiles[i].get_channels();
+		ASSERT(streamChannels[i] == 2);
+	}
+	g_channelMixer.init(kNumAudioStreams, streamChannels, outChannels, kTestBlockSize / 2);
+
+	float matrix[8 * 2];
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		Mixer::make_layout_matrix(Mixer::eChannelLayout::kStereo, kMixOutputLayout, matrix);
+		for (uint32_t o = 0; o < outChannels; ++o)
+		{
+			matrix[o * 2 + 0] *= g_gainFactors[i * 2];
+			matrix[o * 2 + 1] *= g_gainFactors[i * 2 + 1];
+		}
+		g_channelMixer.set_gain_matrix(i, matrix);
+	}
+#endif
+
+#if GAIN_AUTOMATION == 1
+	init_gain_envelopes();
+#endif
 }
 
-// Clears a buffer to zero.
-void clear_buffer(float* out, uint32_t blockSize)
+// Gets the next block of samples for a stream.
+// Mapped float streams are mixed straight from the mapping, prefetched streams hand out
+// their ready block, otherwise the block is read into scratch.
+// Every acquire must be followed by release_input_block once the block has been mixed.
+const float* acquire_input_block(uint32_t stream, float* scratch, uint32_t blockSize)
 {
-	for (uint32_t i = 0; i < blockSize; ++i)
+	WavAudio::WavAudioFileInput& input = g_inputFiles[stream];
+	if (input.data_float() != nullptr)
 	{
-		out[i] = 0;
+		// only a short last block gets copied, to pad it with silence.
+		const float* view = input.read_view(blockSize);
+		if (view != nullptr)
+		{
+			return view;
+		}
+		input.read(scratch, blockSize);
+		return scratch;
 	}
+
+#if PREFETCH_INPUT_FILES == 1
+	ASSERT(blockSize == kTestBlockSize);
+	return g_inputPrefetchers[stream].acquire_block();
+#else
+	input.read(scratch, blockSize);
+	return scratch;
+#endif
 }
 
-void clear_buffer16(int16_t* out, uint32_t blockSize)
+void release_input_block(uint32_t stream)
 {
-	for (uint32_t i = 0; i < blockSize; ++i)
+#if PREFETCH_INPUT_FILES == 1
+	if (g_inputFiles[stream].data_float() == nullptr)
 	{
-		out[i] = 0;
+		g_inputPrefetchers[stream].release_block();
 	}
+#else
+	UNUSED(stream);
+#endif
 }
 
-// Mixes a stereo audio signal contained in a block sized buffer
-// The output buffer is the accumulation of several inputs.
-void mix_buffer(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+#if SILENCE_SKIPPING == 1
+// Steps a stream past a block its activity map marks silent, without decoding it.
+void skip_input_block(uint32_t stream, uint32_t blockSize)
 {
-	TIMER_SCOPED("mix_buffer loop");
-
-#if USING_FMADD_INTRIN == 1
-	#if USING_512_BIT_REGS == 0
-		#if USING_256_BIT_REGS ==0
-			
-			//default 128bit
-			ALIGN16 __m128 outputs_128;
-			ALIGN16 __m128 inputs_128;
-			ALIGN16 __m128 gains_128;
-			ALIGN16 float gainsTemp[4];
-
-			for (uint32_t i = 0; i < (blockSize / 2); i+=2)
-			{
-		#else
-			//256bit
-			ALIGN16 __m256 outputs_256;
-			ALIGN16 __m256 inputs_256;
-			ALIGN16 __m256 gainsl_256;
-			ALIGN16 __m256 gainsr_256;
-
-			const int gainsMask = 0xAA;							//mask of 01010101
-			gainsl_256 = _mm256_set1_ps(leftGain);				//splat left gain to all elements
-			gainsr_256 = _mm256_set1_ps(rightGain);				//splat right gain to all elements
-			gainsl_256 = _mm256_blend_ps(gainsl_256, gainsr_256, gainsMask);	//load alternating values using the mask
-
-			for (uint32_t i = 0; i < (blockSize / 2); i += 4)
-			{
-		#endif
-	#else
-		//512bit
-		ALIGN64 __m512 outputs_512;
-		ALIGN64 __m512 inputs_512;
-		ALIGN64 __m512 gainsl_512;
-		ALIGN64 __m512 gainsr_512;
-
-		__mmask16 gainsMask = 0xAAAA;						//mask of 0101010101010101
-		gainsl_512 = _mm512_set1_ps(leftGain);				//splat left gain to all elements
-		gainsr_512 = _mm512_set1_ps(rightGain);				//splat right gain to all elements
-		gainsl_512 = _mm512_mask_expand_ps(gainsl_512, gainsMask, gainsr_512);	//load alternating values using the mask
-
-		for (uint32_t i = 0; i < (blockSize / 2); i += 8)
-		{
-	#endif
-#else
-	//NO INTRINSIC VECTOR MATHS
-	for (uint32_t i = 0; i < (blockSize / 2); ++i)
+#if PREFETCH_INPUT_FILES == 1
+	if (g_inputFiles[stream].data_float() == nullptr)
 	{
+		// the prefetcher has skipped it already, only its slot is handed back.
+		g_inputPrefetchers[stream].acquire_block();
+		g_inputPrefetchers[stream].release_block();
+		return;
+	}
+#endif
+	g_inputFiles[stream].skip(blockSize);
+}
 #endif
-		uint32_t leftIndex = i * 2;
-		uint32_t rightIndex = i * 2 + 1;
 
-#if USING_FMADD_INTRIN == 0
+// Stops any background readers, drains and closes the output,
+// and reports how often the mixer had to wait on background I/O.
+void finish_audio_files()
+{
+#if PREFETCH_INPUT_FILES == 1
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		g_inputPrefetchers[i].stop();
+		std::cout << "Prefetch stalls " << g_inputFilePaths[i] << ": " << g_inputPrefetchers[i].get_stall_count() << std::endl;
+	}
+#endif
+
+#if SILENCE_SKIPPING == 1
+	// the next run skips what this one mapped.
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		g_activityMaps[i].save();
+	}
+#endif
+
+#if STREAM_PARALLEL_MIXING == 1
+	g_mixPool.stop();
+	std::cout << "Mix pool steals: " << g_mixPool.get_steal_count() << std::endl;
+#endif
 
-		out[leftIndex] += in[leftIndex] * leftGain;
-		out[rightIndex] += in[rightIndex] * rightGain;
+	g_outputFile.close();
+#if WRITE_BEHIND_OUTPUT == 1
+	std::cout << "Write behind stalls " << g_outputFilePath << ": " << g_outputFile.get_write_stall_count() << std::endl;
+#endif
+}
 
+// The whole mix as a job for render_parallel and render_region.
+Mixer::RenderJob make_render_job()
+{
+	Mixer::RenderJob job;
+	job.m_inputPaths = g_inputFilePaths;
+	job.m_gains = g_gainFactors;
+	job.m_numStreams = kNumAudioStreams;
+	job.m_blockSize = kTestBlockSize;
+	job.m_numBlocks = kNumBlocks;
+#if MAPPED_INPUT_FILES == 1
+	job.m_inputMode = WavAudio::eInputMode::kMapped;
 #else
-	#if USING_512_BIT_REGS == 0
-		#if USING_256_BIT_REGS == 0
-			//DEFAULT 128bit
-			gainsTemp[0] = leftGain;
-			gainsTemp[1] = rightGain;
-			gainsTemp[2] = leftGain;
-			gainsTemp[3] = rightGain;
-
-			//fused multiply add intrinsic - 2 samples in one pass - 
-			outputs_128	 = _mm_setzero_ps();					//clear outputs
-			inputs_128	 = _mm_load_ps(&in[leftIndex]);			//Load 128-bits - in1[l] in1[r] & in2[l] in2[r]
-			gains_128	 = _mm_load_ps(gainsTemp);				//load 4 32bit floats in reverse order to the gains memory
-
-			//mul - multioly and accumulate into outputs_128
-			outputs_128	 = _mm_fmadd_ps(inputs_128, gains_128, outputs_128);
-
-			//output to arrays
-			out[leftIndex] += outputs_128.m128_f32[0];
-			out[rightIndex] += outputs_128.m128_f32[1];
-			out[leftIndex +2] += outputs_128.m128_f32[2];
-			out[rightIndex +2] += outputs_128.m128_f32[3];
-		#else
-			//256bit
-			//fused multiply add intrinsic - 2 samples in one pass - 
-			outputs_256 = _mm256_setzero_ps();					//clear outputs
-			inputs_256 = _mm256_load_ps(&in[leftIndex]);		//Load 512-bits - in1[l] in1[r] ... in16[l] in16[r]
-
-			//mul - multioly and accumulate into outputs_512
-			outputs_256 = _mm256_fmadd_ps(inputs_256, gainsl_256, outputs_256);
-
-			//output to arrays
-			for (size_t j(0); j < 8; j += 2)
+	job.m_inputMode = WavAudio::eInputMode::kStream;
+#endif
+	return job;
+}
+
+// Mixes the whole timeline with render_parallel instead of the block by block loop.
+void render_audio_files_parallel()
+{
+	std::cout << "Open output file " << g_outputFilePath << std::endl;
+	WavAudio::FmtChunk format = WavAudio::make_format(kOutputFormat, 2, kOutputSampleRate);
+	g_outputFile.open(g_outputFilePath, format);
+	g_outputFile.print_format_info(std::cout);
+
+	const Mixer::RenderJob job = make_render_job();
+	uint32_t numThreads = 0;
+	TIMER_START("render_parallel()");
+	numThreads = Mixer::render_parallel(job, g_outputFile, kRenderThreads);
+	TIMER_END;
+
+	std::cout << "Render threads: " << numThreads << std::endl;
+	g_outputFile.close();
+}
+
+// Renders through a RemixCache: a second run, or one with a single stem's gain changed,
+// only mixes the sums that changed and reuses the cached ones.
+void render_audio_files_remix()
+{
+	std::cout << "Open output file " << g_outputFilePath << std::endl;
+	WavAudio::FmtChunk format = WavAudio::make_format(kOutputFormat, 2, kOutputSampleRate);
+	g_outputFile.open(g_outputFilePath, format);
+
+	Mixer::RemixCache cache;
+	cache.init(kRemixCacheDir, kStreamsPerGroup);
+
+	Mixer::RemixStats stats;
+	TIMER_START("remix render()");
+	stats = cache.render(make_render_job(), g_outputFile, kRenderThreads);
+	TIMER_END;
+
+	std::cout << "Remix groups reused: " << stats.m_groupsReused << " rendered: " << stats.m_groupsRendered << " sources hashed: " << stats.m_sourcesHashed << std::endl;
+	g_outputFile.close();
+}
+
+// Renders a short region of the finished output again and writes it over the old one,
+// as fixing a few seconds of a long mix would. Only the region's blocks are read and mixed.
+void rerender_output_region()
+{
+	WavAudio::WavAudioFileOutput output;
+	output.open_patch(g_outputFilePath);
+
+	const Mixer::RenderJob job = make_render_job();
+	TIMER_START("render_region()");
+	Mixer::render_region(job, output, kRegionStartFrame, kRegionEndFrame, kRenderThreads);
+	TIMER_END;
+
+	output.close();
+}
+
+#if REALTIME_PUMP_MIXING == 1
+Mixer::RealtimeMixer g_realtimeMixer;
+SpscRing<float> g_realtimeOutput;	// callback -> file writer
+std::atomic<bool> g_realtimeFeedStop{ false };
+std::atomic<uint64_t> g_realtimeDropped{ 0 };
+
+// Source side: decodes the inputs a block at a time and queues them for the callback,
+// backing off while the rings are full.
+void realtime_feed_inputs()
+{
+	const std::chrono::microseconds backoff(static_cast<int64_t>(500000.0 * kRealtimeFrames / (kOutputSampleRate * kRealtimeSpeedup)));
+	for (uint32_t block = 0; block < kNumBlocks && !g_realtimeFeedStop.load(std::memory_order_relaxed); ++block)
+	{
+		for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+		{
+			float* samples = g_mixerContext.get_inputs(i);
+			g_inputFiles[i].read(samples, kTestBlockSize);
+
+			uint32_t queued = 0;
+			while (queued < kTestBlockSize && !g_realtimeFeedStop.load(std::memory_order_relaxed))
 			{
-				out[leftIndex + j] += outputs_256.m256_f32[0 + j];
-				out[rightIndex + j] += outputs_256.m256_f32[0 + j + 1];
+				queued += g_realtimeMixer.write_source(i, samples + queued, kTestBlockSize - queued);
+				if (queued < kTestBlockSize)
+				{
+					std::this_thread::sleep_for(backoff);
+				}
 			}
-		#endif
-	#else
-		//512bit
-		//fused multiply add intrinsic - 2 samples in one pass - 
-		outputs_512 = _mm512_setzero_ps();					//clear outputs
-		inputs_512 = _mm512_load_ps(&in[leftIndex]);		//Load 512-bits - in1[l] in1[r] ... in16[l] in16[r]
-
-		//mul - multioly and accumulate into outputs_512
-		outputs_512 = _mm512_fmadd_ps(inputs_512, gainsl_512, outputs_512);
-
-		//output to arrays
-		for (size_t j(0); j < 16; j += 2)
-		{
-			out[leftIndex + j] += outputs_512.m512_f32[0 + j];
-			out[rightIndex + j] += outputs_512.m512_f32[0 + j + 1];
 		}
+	}
+}
 
-	#endif
-#endif
+// Audio callback, no locks, allocation or file access.
+void realtime_callback(void* context, uint32_t numFrames)
+{
+	float* out = static_cast<float*>(context);
+	g_realtimeMixer.render(out, numFrames);
+	if (g_realtimeOutput.push(out, numFrames * 2) != numFrames * 2)
+	{
+		g_realtimeDropped.fetch_add(1, std::memory_order_relaxed);
 	}
 }
 
-void mix_buffer16(const int16_t* in, int16_t* out, float leftGain, float rightGain, uint32_t blockSize)
+// Mixes the inputs by pumping the real time API from a simulated device clock,
+// the main thread drains the callback output to disk.
+void run_realtime_mix()
 {
-	TIMER_SCOPED("mix_buffer loop");
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		std::cout << "Open input file " << g_inputFilePaths[i] << std::endl;
+		g_inputFiles[i].open(g_inputFilePaths[i], WavAudio::eInputMode::kMapped);
+		g_inputFiles[i].enable_resampling(kOutputSampleRate, kTestBlockSize);
+	}
+
+	std::cout << "Open output file " << g_outputFilePath << std::endl;
+	WavAudio::FmtChunk format = WavAudio::make_format(kOutputFormat, 2, kOutputSampleRate);
+	g_outputFile.open(g_outputFilePath, format);
+
+	// input blocks for the feeder, one more for the writer, output block for the callback.
+	const uint32_t scratchBytes = kTestBlockSize * (format.m_bitsPerSample / 8);
+	g_mixerContext.init(kTestBlockSize, kNumAudioStreams + 1, 1, scratchBytes);
+	g_outputFile.set_scratch_memory(g_mixerContext.get_scratch(0), scratchBytes);
 
-	for (uint32_t i = 0; i < (blockSize / 2); ++i)
+	g_realtimeMixer.init(kNumAudioStreams, kRealtimeFrames, kRealtimeRingFrames, g_gainFactors);
+	g_realtimeOutput.init(static_cast<size_t>(kRealtimeRingFrames) * 2);
+
+	std::thread feeder(realtime_feed_inputs);
+
+	// let the sources fill up before the first callback.
+	while (g_realtimeMixer.get_source_space(kNumAudioStreams - 1) > kRealtimeRingFrames)
 	{
-		uint32_t leftIndex = i * 2;
-		uint32_t rightIndex = i * 2 + 1;
+		std::this_thread::yield();
+	}
+
+	const uint64_t numCallbacks = static_cast<uint64_t>(kNumBlocks) * kTestBlockSize / (kRealtimeFrames * 2);
+	BlockPump pump;
+	pump.start(realtime_callback, g_mixerContext.get_output(), kRealtimeFrames, format.m_samplesPerSec, kRealtimeSpeedup, numCallbacks);
+
+	float* writeBlock = g_mixerContext.get_inputs(kNumAudioStreams);
+	for (;;)
+	{
+		const bool pumpDone = pump.get_callback_count() == numCallbacks;
+		const uint32_t popped = static_cast<uint32_t>(g_realtimeOutput.pop(writeBlock, kTestBlockSize));
+		if (popped > 0)
+		{
+			g_outputFile.write(writeBlock, popped);
+		}
+		else if (pumpDone)
+		{
+			break;
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	pump.wait();
+	g_realtimeFeedStop.store(true, std::memory_order_relaxed);
+	feeder.join();
+	g_outputFile.close();
+
+	std::cout << "Realtime callbacks: " << pump.get_callback_count()
+		<< ", period " << pump.get_period_us() << "us"
+		<< ", max callback " << pump.get_max_callback_us() << "us" << std::endl;
+	std::cout << "Deadline misses: " << pump.get_deadline_miss_count()
+		<< ", source underruns: " << g_realtimeMixer.get_underrun_count()
+		<< ", dropped output blocks: " << g_realtimeDropped.load() << std::endl;
+}
+#endif
+
+// Clears a buffer to zero.
+void clear_buffer(float* out, uint32_t blockSize)
+{
+	Mixer::clear_buffer(out, blockSize);
+}
+
+void clear_buffer16(int16_t* out, uint32_t blockSize)
+{
+	Mixer::clear_buffer16(out, blockSize);
+}
+
+// Mixes a stereo audio signal contained in a block sized buffer
+// The output buffer is the accumulation of several inputs.
+// Runs the widest kernel the host supports, see Mixer::bind_mix_kernels.
+void mix_buffer(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+{
+	TIMER_SAMPLED("mix_buffer loop", kKernelTimerSampleEvery);
 
-		out[leftIndex] += in[leftIndex] * leftGain;
-		out[rightIndex] += in[rightIndex] * rightGain;
+	Mixer::g_mixKernels.m_mixBuffer(in, out, leftGain, rightGain, blockSize);
+}
+
+// Mixes every stream into out in a single pass, out is overwritten so needs no clear.
+// gains holds a Left/Right pair per stream.
+void mix_streams(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	TIMER_SAMPLED("mix_streams loop", kKernelTimerSampleEvery);
+
+#if STREAM_PARALLEL_MIXING == 1
+	UNUSED(numStreams);
+	ASSERT(numStreams == kNumAudioStreams);
+	g_streamMixer.mix(ins, gains, out, blockSize);
+#else
+	Mixer::g_mixKernels.m_mixStreams(ins, gains, numStreams, out, blockSize);
+#endif
+}
+
+#if GAIN_AUTOMATION == 1
+// Mixes every stream into out along g_gainEnvelopes, out is overwritten.
+void mix_streams_automated(const float* const* ins, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	TIMER_SAMPLED("mix_streams_automated loop", kKernelTimerSampleEvery);
+
+	Mixer::mix_streams_automated(ins, g_gainEnvelopes, numStreams, out, g_mixFrame, blockSize / 2);
+	g_mixFrame += blockSize / 2;
+}
+#endif
+
+// Fixed point versions, gains are Q15.
+void mix_buffer16(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize)
+{
+	TIMER_SAMPLED("mix_buffer16 loop", kKernelTimerSampleEvery);
+
+	Mixer::g_mixKernels.m_mixBuffer16(in, out, leftGain, rightGain, blockSize);
+}
+
+void mix_streams16(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize)
+{
+	TIMER_SAMPLED("mix_streams16 loop", kKernelTimerSampleEvery);
+
+	Mixer::g_mixKernels.m_mixStreams16(ins, gains, numStreams, out, blockSize);
+}
+
+// 16 bit samples of one stream straight from the file, mapped inputs without a copy.
+const int16_t* acquire_input_block16(uint32_t stream, uint32_t blockSize)
+{
+	const int16_t* streamInputs = g_inputFiles[stream].read_view16(blockSize);
+	if (streamInputs == nullptr)
+	{
+		int16_t* inputs = g_mixerContext.get_inputs16(stream);
+		g_inputFiles[stream].read16(inputs, blockSize);
+		streamInputs = inputs;
 	}
+	return streamInputs;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -231,20 +623,113 @@ void mix_audio_block(uint32_t blockSize)
 {
 	TIMER_SCOPED("mix_audio_block scope");
 
+	ASSERT(blockSize <= g_mixerContext.get_block_size());
+
+#if INT_16BIT_MIXING == 0 && CHANNEL_MATRIX_MIXING == 1
+	// Deinterleave every stream, mix each output channel as a plane, interleave in the encoder.
+	const float* streams[kNumAudioStreams];
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		streams[i] = acquire_input_block(i, g_mixerContext.get_inputs(i), blockSize);
+	}
+
+	const uint32_t numFrames = blockSize / 2;
+	g_channelMixer.mix(streams, numFrames);
+
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		release_input_block(i);
+	}
+
+	g_outputFile.write_planar(g_channelMixer.get_output_planes(), numFrames);
+#elif INT_16BIT_MIXING == 0 && FUSED_STREAM_MIXING == 1
+	// Load every stream first, then mix them all with one store per output vector.
+	float* output = g_mixerContext.get_output();
+
+	const float* streams[kNumAudioStreams];
+#if SILENCE_SKIPPING == 1
+	// only the streams with something in this block are read and mixed.
+	float gains[kNumAudioStreams * 2];
+	uint32_t active[kNumAudioStreams];
+	uint32_t numActive = 0;
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		WavAudio::ActivityMap& activity = g_activityMaps[i];
+		if (!activity.is_recording() && !activity.is_active(g_mixBlock))
+		{
+			skip_input_block(i, blockSize);
+			continue;
+		}
+		streams[numActive] = acquire_input_block(i, g_mixerContext.get_inputs(i), blockSize);
+		if (activity.is_recording())
+		{
+			// the block is hot in cache, its peak is nearly free next to decoding it.
+			activity.record(g_mixBlock, streams[numActive], blockSize);
+		}
+		gains[numActive * 2] = g_gainFactors[i * 2];
+		gains[numActive * 2 + 1] = g_gainFactors[i * 2 + 1];
+		active[numActive++] = i;
+	}
+	++g_mixBlock;
+
+	if (numActive == 0)
+	{
+		g_outputFile.write_silence(blockSize);
+		return;
+	}
+
+	mix_streams(streams, gains, numActive, output, blockSize);
+
+	for (uint32_t a = 0; a < numActive; ++a)
+	{
+		release_input_block(active[a]);
+	}
+#else
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		streams[i] = acquire_input_block(i, g_mixerContext.get_inputs(i), blockSize);
+	}
+
+#if GAIN_AUTOMATION == 1
+	mix_streams_automated(streams, kNumAudioStreams, output, blockSize);
+#else
+	mix_streams(streams, g_gainFactors, kNumAudioStreams, output, blockSize);
+#endif
+
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		release_input_block(i);
+	}
+#endif
+
+	// Write to output file
+	g_outputFile.write(output, blockSize);
+#elif INT_16BIT_MIXING == 1 && FUSED_STREAM_MIXING == 1
+	// Fixed point, the 16 bit samples go from the file to the output without touching float.
+	int16_t* output = g_mixerContext.get_output16();
+
+	const int16_t* streams[kNumAudioStreams];
+	for (uint32_t i = 0; i < kNumAudioStreams; ++i)
+	{
+		streams[i] = acquire_input_block16(i, blockSize);
+	}
+
+	mix_streams16(streams, g_gainFactorsQ15, kNumAudioStreams, output, blockSize);
+
+	g_outputFile.write16(output, blockSize);
+#else
 #if INT_16BIT_MIXING == 0
 	// Prepare to mix this block
-	// Allocate some memory to load samples.
-	ALIGN16 float* inputs = new float[blockSize];
-	// And the output.
-	ALIGN16 float* output = new float[blockSize];
+	// Memory to load samples into, and the output.
+	float* inputs = g_mixerContext.get_inputs(0);
+	float* output = g_mixerContext.get_output();
 
 	// Clear output ready to accumulate
 	clear_buffer(output, blockSize);
 #else
 	//16 bit
-	ALIGN16 int16_t* inputs = new int16_t[blockSize];
-	// And the output.
-	ALIGN16 int16_t* output = new int16_t[blockSize];
+	// The output.
+	int16_t* output = g_mixerContext.get_output16();
 
 	// Clear output ready to accumulate
 	clear_buffer16(output, blockSize);
@@ -257,12 +742,13 @@ void mix_audio_block(uint32_t blockSize)
 		uint32_t rightIndex = i * 2 + 1;
 
 #if INT_16BIT_MIXING == 0
-		g_inputFiles[i].read(inputs, blockSize);
-		mix_buffer(inputs, output, g_gainFactors[leftIndex], g_gainFactors[rightIndex], blockSize);
+		const float* streamInputs = acquire_input_block(i, inputs, blockSize);
+		mix_buffer(streamInputs, output, g_gainFactors[leftIndex], g_gainFactors[rightIndex], blockSize);
+		release_input_block(i);
 #else
-		//read 16
-		g_inputFiles[i].read16(inputs, blockSize);	
-		mix_buffer16(inputs, output, g_gainFactors[leftIndex], g_gainFactors[rightIndex], blockSize);
+		//read 16, mapped inputs are mixed in place without a copy
+		const int16_t* streamInputs = acquire_input_block16(i, blockSize);
+		mix_buffer16(streamInputs, output, g_gainFactorsQ15[leftIndex], g_gainFactorsQ15[rightIndex], blockSize);
 #endif
 	}
 
@@ -273,17 +759,69 @@ void mix_audio_block(uint32_t blockSize)
 	// Write 16 bit
 	g_outputFile.write16(output, blockSize);
 #endif
-
-	// Clean up memory.	
-	delete[] inputs;
-	delete[] output;
+#endif
 }
 
 // Main entry point function.
 int main()
 {
+	TIMER_THREAD_NAME("main");
+
+	// Pick the widest mixing kernels and sample codecs this host can run.
+	Mixer::bind_mix_kernels();
+	WavAudio::bind_pcm_codecs();
+	std::cout << "Cpu features:";
+	print_cpu_features(std::cout);
+	std::cout << "Mix kernels: " << get_kernel_isa_name(Mixer::g_mixKernels.m_isa) << std::endl;
+	std::cout << "Sample codecs: " << get_kernel_isa_name(WavAudio::g_pcmCodecs.m_isa) << std::endl;
+
+	Mixer::to_q15_gains(g_gainFactors, g_gainFactorsQ15, kNumAudioStreams * 2);
+
+#if defined _DEBUG
+	ASSERT(WavAudio::verify_pcm_codecs(std::cout));
+	ASSERT(Mixer::verify_mix_kernels16(std::cout));
+#if REMIX_CACHE == 1
+	ASSERT(Mixer::verify_remix_cache(kRemixCacheDir, std::cout));
+#endif
+#endif
+
+#if RUN_KERNEL_BENCHMARKS == 1
+	run_kernel_benchmarks(std::cout);
+	run_stream_parallel_benchmarks(std::cout);
+	return 0;
+#endif
+
+#if RUN_BENCHMARK_SUITE == 1
+	run_benchmark_suite(std::cout);
+	return 0;
+#endif
+
+#if REALTIME_PUMP_MIXING == 1
+	run_realtime_mix();
+	std::cout << "Finished: Output audio in " << g_outputFilePath << std::endl;
+	return 0;
+#endif
+
+#if REMIX_CACHE == 1
+	render_audio_files_remix();
+	std::cout << "Finished: Output audio in " << g_outputFilePath << std::endl;
+	TIMER_OUTALL_ATEXIT;
+	return 0;
+#endif
+
+#if PARALLEL_OFFLINE_RENDER == 1
+	render_audio_files_parallel();
+#if REGION_RERENDER == 1
+	rerender_output_region();
+#endif
+	std::cout << "Finished: Output audio in " << g_outputFilePath << std::endl;
+	TIMER_OUTALL_ATEXIT;
+	return 0;
+#endif
+
 	prepare_audio_files();
 
+	TIMER_CALIBRATE();
 	TIMER_START("main() mix loop");
 
 	for (uint32_t i = 0; i < kNumBlocks; ++i)
@@ -293,6 +831,12 @@ int main()
 
 	TIMER_END;
 
+	finish_audio_files();
+
+#if REGION_RERENDER == 1
+	rerender_output_region();
+#endif
+
 	std::cout << "Finished: Output audio in " << g_outputFilePath << std::endl;
 
 	TIMER_OUTALL_ATEXIT;
@@ -0,0 +1,497 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.h"
+#include "MixKernels.h"
+#include "StreamParallelMixer.h"
+#include "PcmCodecs.h"
+#include "WaveFile.h"
+#include "Profiler.h"
+#include "Resampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <iomanip>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kBenchBlockSize = 4096;
+constexpr uint32_t kBenchStreams = 4;
+constexpr double kBenchSeconds = 0.25; // minimum time spent per kernel
+constexpr uint32_t kParallelBenchStreams = 256;
+constexpr uint32_t kParallelBenchGroupSize = 16;
+
+// benchmark suite sweeps.
+constexpr double kSuiteSeconds = 0.05; // minimum time spent per case
+const uint32_t kSuiteBlockSizes[] = { 64, 256, 1024, 4096, 16384, 65536 };
+const uint32_t kSuiteStreamCounts[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+const uint32_t kSuiteResampleRates[] = { 44100, 96000 }; // stereo inputs converted to 48kHz
+constexpr uint32_t kSuiteMaxBlockSize = 65536;
+constexpr uint32_t kSuiteMaxStreams = 256;
+constexpr uint32_t kSuiteStreamBlockSize = 4096;
+constexpr uint32_t kSuiteFileSamples = 1 << 21; // generated input, 4MB of 16 bit samples
+constexpr uint64_t kSuiteMaxOutputBytes = 64ull << 20; // output is reopened once it grows past this
+const char* const kSuiteInputPath = "bench_input.wav";
+const char* const kSuiteOutputPath = "bench_output.wav";
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Fills a buffer with a deterministic signal in [-1, 1].
+void fill_signal(std::vector<float>& buffer, uint32_t seed)
+{
+	uint32_t state = seed * 747796405u + 2891336453u;
+	for (float& sample : buffer)
+	{
+		state = state * 1664525u + 1013904223u;
+		sample = static_cast<float>(static_cast<int32_t>(state)) / 2147483648.0f;
+	}
+}
+
+// Cost of one call to a benchmarked function.
+struct BenchResult
+{
+	double m_seconds;
+	double m_ticks;	// Profiler::read_ticks, cpu reference cycles when it reads the timestamp counter
+};
+
+// Repeats func until minSeconds has passed, returns the average cost per call.
+template<typename Func>
+BenchResult measure_call(double minSeconds, Func func)
+{
+	// warm up caches and the branch predictor.
+	func();
+
+	uint64_t calls = 0;
+	const BenchClock::time_point start = BenchClock::now();
+	const uint64_t startTicks = Profiler::read_ticks();
+	std::chrono::duration<double> elapsed(0);
+	do
+	{
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			func();
+		}
+		calls += 16;
+		elapsed = BenchClock::now() - start;
+	} while (elapsed.count() < minSeconds);
+	const uint64_t ticks = Profiler::read_ticks() - startTicks;
+
+	return { elapsed.count() / calls, static_cast<double>(ticks) / calls };
+}
+
+// Repeats func until kBenchSeconds has passed, returns processed samples per second.
+template<typename Func>
+double measure_samples_per_sec(uint64_t samplesPerCall, Func func)
+{
+	return samplesPerCall / measure_call(kBenchSeconds, func).m_seconds;
+}
+
+void print_result(std::ostream& streamOut, const char* kernel, eKernelIsa isa, double samplesPerSec)
+{
+	streamOut << "\t" << std::left << std::setw(12) << kernel
+		<< std::setw(8) << get_kernel_isa_name(isa)
+		<< std::right << std::fixed << std::setprecision(1) << std::setw(10) << samplesPerSec / 1.0e6 << " Msamples/sec\n";
+}
+
+// One suite row: name/args, time per call, samples/sec and bytes moved per cycle.
+// bytes counts every byte the call loads or stores, e.g. mix_buffer reads in and out and writes out.
+void print_case(std::ostream& streamOut, const std::string& name, const BenchResult& result, uint64_t samples, uint64_t bytes)
+{
+	streamOut << std::left << std::setw(48) << name << std::right
+		<< std::fixed << std::setprecision(1) << std::setw(12) << result.m_seconds * 1.0e9 << " ns"
+		<< std::setw(12) << samples / result.m_seconds / 1.0e6 << " Msamples/s";
+#if PROFILER_RDTSC == 1
+	streamOut << std::setprecision(2) << std::setw(10) << bytes / result.m_ticks << " bytes/cycle";
+#else
+	UNUSED(bytes);
+#endif
+	streamOut << "\n";
+}
+
+std::string case_name(const char* name, const char* arg0, uint32_t arg1)
+{
+	std::ostringstream s;
+	s << name;
+	if (arg0 != nullptr)
+	{
+		s << "/" << arg0;
+	}
+	s << "/" << arg1;
+	return s.str();
+}
+
+// Converts a float signal to int16 samples.
+void fill_signal16(const std::vector<float>& signal, std::vector<int16_t>& out)
+{
+	out.resize(signal.size());
+	for (size_t i = 0; i < signal.size(); ++i)
+	{
+		out[i] = static_cast<int16_t>(signal[i] * 32767.0f);
+	}
+}
+
+} // namespace
+
+void run_kernel_benchmarks(std::ostream& streamOut)
+{
+	std::vector<std::vector<float>> inputs(kBenchStreams, std::vector<float>(kBenchBlockSize));
+	const float* streams[kBenchStreams];
+	for (uint32_t i = 0; i < kBenchStreams; ++i)
+	{
+		fill_signal(inputs[i], i + 1);
+		streams[i] = inputs[i].data();
+	}
+
+	// Small gains keep the accumulator from growing without bound over many calls.
+	float gains[kBenchStreams * 2];
+	for (uint32_t i = 0; i < kBenchStreams * 2; ++i)
+	{
+		gains[i] = 0.001f * (i + 1);
+	}
+
+	std::vector<float> output(kBenchBlockSize, 0.0f);
+
+	streamOut << "Kernel benchmarks, block size " << kBenchBlockSize << ", " << kBenchStreams << " streams\n";
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(eKernelIsa::kCount); ++i)
+	{
+		const eKernelIsa isa = static_cast<eKernelIsa>(i);
+		if (!is_kernel_isa_supported(isa))
+		{
+			streamOut << "\t" << get_kernel_isa_name(isa) << " not supported on this cpu\n";
+			continue;
+		}
+
+		const Mixer::MixKernelTable kernels = Mixer::get_mix_kernels(isa);
+
+		// samples counted per input stream sample consumed.
+		const double mixBuffer = measure_samples_per_sec(kBenchBlockSize, [&]() {
+			kernels.m_mixBuffer(streams[0], output.data(), gains[0], gains[1], kBenchBlockSize);
+		});
+		print_result(streamOut, "mix_buffer", isa, mixBuffer);
+
+		const double mixStreams = measure_samples_per_sec(kBenchBlockSize * kBenchStreams, [&]() {
+			kernels.m_mixStreams(streams, gains, kBenchStreams, output.data(), kBenchBlockSize);
+		});
+		print_result(streamOut, "mix_streams", isa, mixStreams);
+	}
+}
+
+void run_stream_parallel_benchmarks(std::ostream& streamOut)
+{
+	std::vector<std::vector<float>> inputs(kParallelBenchStreams, std::vector<float>(kBenchBlockSize));
+	std::vector<const float*> streams(kParallelBenchStreams);
+	for (uint32_t i = 0; i < kParallelBenchStreams; ++i)
+	{
+		fill_signal(inputs[i], i + 1);
+		streams[i] = inputs[i].data();
+	}
+
+	// gains scaled so the mix stays in [-1, 1].
+	std::vector<float> gains(kParallelBenchStreams * 2);
+	for (uint32_t i = 0; i < kParallelBenchStreams * 2; ++i)
+	{
+		gains[i] = (0.5f + 0.5f * (i % 7) / 6.0f) / kParallelBenchStreams;
+	}
+
+	// serial left to right reference in double.
+	std::vector<double> reference(kBenchBlockSize, 0.0);
+	for (uint32_t s = 0; s < kParallelBenchStreams; ++s)
+	{
+		for (uint32_t i = 0; i < kBenchBlockSize; ++i)
+		{
+			reference[i] += static_cast<double>(streams[s][i]) * gains[s * 2 + (i & 1)];
+		}
+	}
+
+	std::vector<float> output(kBenchBlockSize);
+
+	streamOut << "Stream parallel mixing, block size " << kBenchBlockSize << ", " << kParallelBenchStreams
+		<< " streams in groups of " << kParallelBenchGroupSize << "\n";
+
+	// 1, 2, 4... threads and then every hardware thread.
+	const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+	{
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	for (uint32_t numThreads : threadCounts)
+	{
+		// the caller is one of the threads.
+		WorkStealingPool pool;
+		if (numThreads > 1)
+		{
+			pool.start(numThreads - 1);
+		}
+
+		Mixer::StreamParallelMixer mixer;
+		mixer.init(pool, kParallelBenchStreams, kParallelBenchGroupSize, kBenchBlockSize);
+
+		const double samplesPerSec = measure_samples_per_sec(kBenchBlockSize, [&]() {
+			mixer.mix(streams.data(), gains.data(), output.data(), kBenchBlockSize);
+		});
+
+		double maxError = 0.0;
+		for (uint32_t i = 0; i < kBenchBlockSize; ++i)
+		{
+			maxError = std::max(maxError, std::fabs(output[i] - reference[i]));
+		}
+
+		streamOut << "\t" << std::setw(3) << numThreads << " threads "
+			<< std::fixed << std::setprecision(1) << std::setw(10) << 1.0e6 * kBenchBlockSize / samplesPerSec << " us/block"
+			<< "   max error " << std::scientific << std::setprecision(2) << maxError
+			<< "   steals " << pool.get_steal_count() << std::defaultfloat << "\n";
+	}
+}
+
+void run_benchmark_suite(std::ostream& streamOut)
+{
+	// every input is generated, the suite needs no audio files.
+	std::vector<std::vector<float>> inputs(kSuiteMaxStreams, std::vector<float>(kSuiteMaxBlockSize));
+	std::vector<const float*> streams(kSuiteMaxStreams);
+	for (uint32_t i = 0; i < kSuiteMaxStreams; ++i)
+	{
+		fill_signal(inputs[i], i + 1);
+		streams[i] = inputs[i].data();
+	}
+
+	std::vector<float> gains(kSuiteMaxStreams * 2);
+	for (uint32_t i = 0; i < kSuiteMaxStreams * 2; ++i)
+	{
+		gains[i] = 0.5f / kSuiteMaxStreams;
+	}
+
+	// ramps from half to the full gain across the largest block, alternating shapes.
+	std::vector<Mixer::GainRamp> ramps(kSuiteMaxStreams);
+	for (uint32_t i = 0; i < kSuiteMaxStreams; ++i)
+	{
+		const float startGains[2] = { gains[i * 2] * 0.5f, gains[i * 2 + 1] * 0.5f };
+		ramps[i] = Mixer::make_gain_ramp(startGains, &gains[i * 2], kSuiteMaxBlockSize / 2, i & 1 ? Mixer::eRampShape::kExponential : Mixer::eRampShape::kLinear);
+	}
+
+	// the same signals and gains for the fixed point kernels.
+	std::vector<std::vector<int16_t>> inputs16(kSuiteMaxStreams);
+	std::vector<const int16_t*> streams16(kSuiteMaxStreams);
+	for (uint32_t i = 0; i < kSuiteMaxStreams; ++i)
+	{
+		fill_signal16(inputs[i], inputs16[i]);
+		streams16[i] = inputs16[i].data();
+	}
+	const std::vector<int16_t>& input16 = inputs16[0];
+
+	std::vector<int16_t> gainsQ15(kSuiteMaxStreams * 2);
+	Mixer::to_q15_gains(gains.data(), gainsQ15.data(), kSuiteMaxStreams * 2);
+
+	std::vector<float> output(kSuiteMaxBlockSize, 0.0f);
+	std::vector<int16_t> output16(kSuiteMaxBlockSize, 0);
+	std::vector<uint8_t> pcm(kSuiteMaxBlockSize * 4);
+
+	streamOut << "Benchmark suite" << (PROFILER_RDTSC == 1 ? ", cycles are timestamp counter reference cycles" : "") << "\n";
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(eKernelIsa::kCount); ++i)
+	{
+		const eKernelIsa isa = static_cast<eKernelIsa>(i);
+		if (!is_kernel_isa_supported(isa))
+		{
+			continue;
+		}
+
+		const Mixer::MixKernelTable kernels = Mixer::get_mix_kernels(isa);
+		const WavAudio::PcmCodecTable codecs = WavAudio::get_pcm_codecs(isa);
+		const char* const isaName = get_kernel_isa_name(isa);
+
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			std::fill(output.begin(), output.end(), 0.0f);
+			print_case(streamOut, case_name("mix_buffer", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixBuffer(streams[0], output.data(), gains[0], gains[1], blockSize);
+			}), blockSize, blockSize * sizeof(float) * 3ull);
+		}
+
+		for (uint32_t numStreams : kSuiteStreamCounts)
+		{
+			print_case(streamOut, case_name("mix_streams", isaName, numStreams), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixStreams(streams.data(), gains.data(), numStreams, output.data(), kSuiteStreamBlockSize);
+			}), static_cast<uint64_t>(numStreams) * kSuiteStreamBlockSize, (numStreams + 1ull) * kSuiteStreamBlockSize * sizeof(float));
+		}
+
+		// the same mixes with every gain ramping, to compare against the constant gains above.
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			std::fill(output.begin(), output.end(), 0.0f);
+			print_case(streamOut, case_name("mix_buffer_ramp", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixBufferRamp(streams[0], output.data(), ramps[0], blockSize);
+			}), blockSize, blockSize * sizeof(float) * 3ull);
+		}
+
+		for (uint32_t numStreams : kSuiteStreamCounts)
+		{
+			print_case(streamOut, case_name("mix_streams_ramp", isaName, numStreams), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixStreamsRamp(streams.data(), ramps.data(), numStreams, output.data(), kSuiteStreamBlockSize);
+			}), static_cast<uint64_t>(numStreams) * kSuiteStreamBlockSize, (numStreams + 1ull) * kSuiteStreamBlockSize * sizeof(float));
+		}
+
+		for (uint32_t numPlanes : kSuiteStreamCounts)
+		{
+			print_case(streamOut, case_name("mix_planes", isaName, numPlanes), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixPlanes(streams.data(), gains.data(), numPlanes, output.data(), kSuiteStreamBlockSize);
+			}), static_cast<uint64_t>(numPlanes) * kSuiteStreamBlockSize, (numPlanes + 1ull) * kSuiteStreamBlockSize * sizeof(float));
+		}
+
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			std::fill(output16.begin(), output16.end(), int16_t(0));
+			print_case(streamOut, case_name("mix_buffer16", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixBuffer16(streams16[0], output16.data(), gainsQ15[0], gainsQ15[1], blockSize);
+			}), blockSize, blockSize * sizeof(int16_t) * 3ull);
+		}
+
+		for (uint32_t numStreams : kSuiteStreamCounts)
+		{
+			print_case(streamOut, case_name("mix_streams16", isaName, numStreams), measure_call(kSuiteSeconds, [&]() {
+				kernels.m_mixStreams16(streams16.data(), gainsQ15.data(), numStreams, output16.data(), kSuiteStreamBlockSize);
+			}), static_cast<uint64_t>(numStreams) * kSuiteStreamBlockSize, (numStreams + 1ull) * kSuiteStreamBlockSize * sizeof(int16_t));
+		}
+
+		// 16 bit samples encoded from the signal, shared by the decoders below.
+		codecs.m_encode16(inputs[0].data(), pcm.data(), kSuiteMaxBlockSize);
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			print_case(streamOut, case_name("decode16", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_decode16(pcm.data(), output.data(), blockSize);
+			}), blockSize, blockSize * (2ull + sizeof(float)));
+
+			print_case(streamOut, case_name("encode16", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_encode16(inputs[0].data(), pcm.data(), blockSize);
+			}), blockSize, blockSize * (sizeof(float) + 2ull));
+
+			print_case(streamOut, case_name("decode24", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_decode24(pcm.data(), output.data(), blockSize);
+			}), blockSize, blockSize * (3ull + sizeof(float)));
+
+			print_case(streamOut, case_name("encode24", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_encode24(inputs[0].data(), pcm.data(), blockSize);
+			}), blockSize, blockSize * (sizeof(float) + 3ull));
+
+			print_case(streamOut, case_name("decode32", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_decode32(pcm.data(), output.data(), blockSize);
+			}), blockSize, blockSize * (4ull + sizeof(float)));
+
+			print_case(streamOut, case_name("encode32", isaName, blockSize), measure_call(kSuiteSeconds, [&]() {
+				codecs.m_encode32(inputs[0].data(), pcm.data(), blockSize);
+			}), blockSize, blockSize * (sizeof(float) + 4ull));
+		}
+
+		// samples are output samples, the input is rewound whenever it would run out.
+		for (uint32_t inRate : kSuiteResampleRates)
+		{
+			WavAudio::Resampler resampler;
+			resampler.init(inRate, 48000, 2, kSuiteStreamBlockSize / 2, isa);
+			uint32_t inputFrame = 0;
+			uint64_t inputSamples = 0;
+			uint64_t calls = 0;
+			const BenchResult result = measure_call(kSuiteSeconds, [&]() {
+				const uint32_t needed = resampler.get_input_frames_needed(kSuiteStreamBlockSize / 2);
+				if ((inputFrame + needed) * 2 > kSuiteMaxBlockSize)
+				{
+					inputFrame = 0;
+				}
+				resampler.process(inputs[0].data() + inputFrame * 2, needed, output.data(), kSuiteStreamBlockSize / 2);
+				inputFrame += needed;
+				inputSamples += needed * 2;
+				++calls;
+			});
+			print_case(streamOut, case_name("resample", isaName, inRate), result, kSuiteStreamBlockSize, (inputSamples / calls + kSuiteStreamBlockSize) * sizeof(float));
+		}
+	}
+
+	// scalar only paths.
+	for (uint32_t blockSize : kSuiteBlockSizes)
+	{
+		print_case(streamOut, case_name("clear_buffer", nullptr, blockSize), measure_call(kSuiteSeconds, [&]() {
+			Mixer::clear_buffer(output.data(), blockSize);
+		}), blockSize, blockSize * sizeof(float));
+
+		print_case(streamOut, case_name("clear_buffer16", nullptr, blockSize), measure_call(kSuiteSeconds, [&]() {
+			Mixer::clear_buffer16(output16.data(), blockSize);
+		}), blockSize, blockSize * sizeof(int16_t));
+
+		print_case(streamOut, case_name("decode_16bit_pcm_to_16bit", nullptr, blockSize), measure_call(kSuiteSeconds, [&]() {
+			WavAudio::decode_16bit_pcm_to_16bit(pcm.data(), output16.data(), blockSize);
+		}), blockSize, blockSize * 4ull);
+
+		print_case(streamOut, case_name("encode_16bit_to_16bit", nullptr, blockSize), measure_call(kSuiteSeconds, [&]() {
+			WavAudio::encode_16bit_to_16bit(input16.data(), pcm.data(), blockSize);
+		}), blockSize, blockSize * 4ull);
+	}
+
+	// File paths, through a generated 16 bit stereo file.
+	const WavAudio::FmtChunk format = WavAudio::make_format(WavAudio::eAudioFormat::kFormat_16bitPCM, 2, 48000);
+	{
+		WavAudio::WavAudioFileOutput generated(kSuiteInputPath, format);
+		for (uint32_t written = 0; written < kSuiteFileSamples; written += kSuiteMaxBlockSize)
+		{
+			generated.write(inputs[written / kSuiteMaxBlockSize % kSuiteMaxStreams].data(), kSuiteMaxBlockSize);
+		}
+	}
+
+	const WavAudio::eInputMode inputModes[] = { WavAudio::eInputMode::kStream, WavAudio::eInputMode::kMapped };
+	const char* const inputModeNames[] = { "stream", "mapped" };
+	for (uint32_t mode = 0; mode < 2; ++mode)
+	{
+		WavAudio::WavAudioFileInput input(kSuiteInputPath, inputModes[mode]);
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			print_case(streamOut, case_name("WavAudioFileInput::read", inputModeNames[mode], blockSize), measure_call(kSuiteSeconds, [&]() {
+				// loop over the file so the read cost is never a short read at the end.
+				if (input.samples_remaining() < blockSize)
+				{
+					input.seek_sample(0);
+				}
+				input.read(output.data(), blockSize);
+			}), blockSize, blockSize * (2ull + sizeof(float)));
+		}
+	}
+
+	const char* const outputModeNames[] = { "direct", "write_behind" };
+	for (uint32_t mode = 0; mode < 2; ++mode)
+	{
+		for (uint32_t blockSize : kSuiteBlockSizes)
+		{
+			WavAudio::WavAudioFileOutput output16File(kSuiteOutputPath, format);
+			if (mode == 1)
+			{
+				output16File.enable_write_behind(2 * 1024 * 1024, 3);
+			}
+
+			// reopen now and then so the benchmark does not fill the disk.
+			uint64_t writtenBytes = 0;
+			print_case(streamOut, case_name("WavAudioFileOutput::write", outputModeNames[mode], blockSize), measure_call(kSuiteSeconds, [&]() {
+				if (writtenBytes > kSuiteMaxOutputBytes)
+				{
+					output16File.close();
+					output16File.open(kSuiteOutputPath, format);
+					if (mode == 1)
+					{
+						output16File.enable_write_behind(2 * 1024 * 1024, 3);
+					}
+					writtenBytes = 0;
+				}
+				output16File.write(inputs[0].data(), blockSize);
+				writtenBytes += blockSize * 2ull;
+			}), blockSize, blockSize * (sizeof(float) + 2ull));
+		}
+	}
+
+	std::remove(kSuiteInputPath);
+	std::remove(kSuiteOutputPath);
+}
@@ -0,0 +1,21 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <ostream>
+
+// Microbenchmarks for the mixing kernels.
+// Runs every kernel width the host supports on synthetic data and reports samples/sec.
+void run_kernel_benchmarks(std::ostream& streamOut);
+
+// Mixes a few hundred streams with StreamParallelMixer on 1, 2, 4... threads and reports
+// the time per block along with the largest difference from a serial sum.
+void run_stream_parallel_benchmarks(std::ostream& streamOut);
+
+// Full sweep on generated data, no audio files needed: mix_buffer and mix_buffer16 for every
+// kernel width at block sizes 64 to 65536, mix_streams, mix_planes and mix_streams16 for 1 to 256 streams,
+// every sample codec, clear_buffer and the file read/write paths. Each case reports time per call, samples/sec
+// and bytes loaded plus stored per cycle.
+void run_benchmark_suite(std::ostream& streamOut);
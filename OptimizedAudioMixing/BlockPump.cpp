@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "BlockPump.h"
+#include "Profiler.h"
+
+BlockPump::BlockPump()
+	: m_callback{ nullptr }
+	, m_context{ nullptr }
+	, m_framesPerCallback{ 0 }
+	, m_numCallbacks{ 0 }
+	, m_period{ 0 }
+	, m_stopRequested{ false }
+	, m_callbackCount{ 0 }
+	, m_deadlineMissCount{ 0 }
+	, m_maxCallbackNs{ 0 }
+{}
+
+BlockPump::~BlockPump()
+{
+	stop();
+}
+
+void BlockPump::start(BlockCallback callback, void* context, uint32_t framesPerCallback, uint32_t sampleRate, double speedup, uint64_t numCallbacks)
+{
+	ASSERT(callback != nullptr && framesPerCallback > 0 && sampleRate > 0 && speedup > 0.0);
+	stop();
+
+	m_callback = callback;
+	m_context = context;
+	m_framesPerCallback = framesPerCallback;
+	m_numCallbacks = numCallbacks;
+	m_period = std::chrono::nanoseconds(static_cast<int64_t>(1.0e9 * framesPerCallback / (sampleRate * speedup)));
+
+	m_stopRequested.store(false, std::memory_order_relaxed);
+	m_callbackCount.store(0, std::memory_order_relaxed);
+	m_deadlineMissCount.store(0, std::memory_order_relaxed);
+	m_maxCallbackNs.store(0, std::memory_order_relaxed);
+
+	m_thread = std::thread(&BlockPump::clock_thread, this);
+}
+
+void BlockPump::stop()
+{
+	m_stopRequested.store(true, std::memory_order_relaxed);
+	wait();
+}
+
+void BlockPump::wait()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void BlockPump::clock_thread()
+{
+	TIMER_THREAD_NAME("audio callback");
+
+	Clock::time_point tick = Clock::now();
+	uint64_t callbacks = 0;
+	uint64_t maxCallbackNs = 0;
+
+	while (!m_stopRequested.load(std::memory_order_relaxed) && (m_numCallbacks == 0 || callbacks < m_numCallbacks))
+	{
+		const Clock::time_point deadline = tick + m_period;
+
+		const Clock::time_point started = Clock::now();
+		{
+			TIMER_SCOPED("block callback");
+			m_callback(m_context, m_framesPerCallback);
+		}
+
+		const Clock::time_point finished = Clock::now();
+		const uint64_t callbackNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count());
+		if (finished > deadline)
+		{
+			m_deadlineMissCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (callbackNs > maxCallbackNs)
+		{
+			maxCallbackNs = callbackNs;
+			m_maxCallbackNs.store(maxCallbackNs, std::memory_order_relaxed);
+		}
+		m_callbackCount.store(++callbacks, std::memory_order_relaxed);
+
+		// the next buffer is due one period after this one, whether or not we were late.
+		tick = deadline;
+		std::this_thread::sleep_until(tick);
+	}
+}
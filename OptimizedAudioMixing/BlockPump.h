@@ -0,0 +1,63 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Stands in for an audio device: calls a block callback on its own thread once per period
+// of a simulated fixed period clock, the way a driver asks for the next buffer.
+// Each callback has until the next tick to return, finishing later is a deadline miss.
+// The clock does not slip when a callback overruns, like real hardware the next tick is
+// still due one period after the previous one.
+//
+// speedup runs the clock faster than real time, e.g. 4 makes a 5.3ms period tick every 1.3ms,
+// so long files can be pushed through the same deadline checks quickly.
+class BlockPump
+{
+public:
+	typedef void (*BlockCallback)(void* context, uint32_t numFrames);
+
+	BlockPump();
+	~BlockPump();
+
+	BlockPump(const BlockPump&) = delete;
+	BlockPump& operator = (const BlockPump&) = delete;
+
+	// Starts ticking. numCallbacks stops the clock after that many callbacks, 0 runs until stop().
+	void start(BlockCallback callback, void* context, uint32_t framesPerCallback, uint32_t sampleRate, double speedup, uint64_t numCallbacks);
+
+	// Stops the clock and joins its thread.
+	void stop();
+
+	// Blocks until numCallbacks have been made, then joins the thread.
+	void wait();
+
+	uint64_t get_callback_count() const { return m_callbackCount.load(std::memory_order_relaxed); }
+	uint64_t get_deadline_miss_count() const { return m_deadlineMissCount.load(std::memory_order_relaxed); }
+
+	// Longest callback and the tick period, in microseconds.
+	double get_max_callback_us() const { return m_maxCallbackNs.load(std::memory_order_relaxed) / 1000.0; }
+	double get_period_us() const { return m_period.count() / 1000.0; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void clock_thread();
+
+	BlockCallback m_callback;
+	void* m_context;
+	uint32_t m_framesPerCallback;
+	uint64_t m_numCallbacks;
+	std::chrono::nanoseconds m_period;
+
+	std::atomic<bool> m_stopRequested;
+	std::atomic<uint64_t> m_callbackCount;
+	std::atomic<uint64_t> m_deadlineMissCount;
+	std::atomic<uint64_t> m_maxCallbackNs;
+
+	std::thread m_thread;
+};
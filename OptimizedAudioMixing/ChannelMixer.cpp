@@ -0,0 +1,249 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "ChannelMixer.h"
+#include "MixKernels.h"
+#include "PcmCodecs.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace Mixer {
+
+namespace {
+
+constexpr float kMinus3dB = 0.70710678f;
+
+const uint32_t kLayoutChannels[] = { 1, 2, 6, 8 };
+
+// Left/Right gains of each channel when folded down to stereo, in layout channel order.
+const float kStereoFoldMono[][2] = { { kMinus3dB, kMinus3dB } };
+const float kStereoFoldStereo[][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+const float kStereoFold5_1[][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f }, { kMinus3dB, kMinus3dB }, { 0.0f, 0.0f }, { kMinus3dB, 0.0f }, { 0.0f, kMinus3dB } };
+const float kStereoFold7_1[][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f }, { kMinus3dB, kMinus3dB }, { 0.0f, 0.0f }, { kMinus3dB, 0.0f }, { 0.0f, kMinus3dB }, { kMinus3dB, 0.0f }, { 0.0f, kMinus3dB } };
+
+const float (*get_stereo_fold(eChannelLayout layout))[2]
+{
+	switch (layout)
+	{
+	case eChannelLayout::kMono: return kStereoFoldMono;
+	case eChannelLayout::kStereo: return kStereoFoldStereo;
+	case eChannelLayout::k5_1: return kStereoFold5_1;
+	default: return kStereoFold7_1;
+	}
+}
+
+constexpr uint32_t kCenter = 2;
+constexpr uint32_t kBackLeft = 4;
+constexpr uint32_t kSideLeft = 6;
+
+} // namespace
+
+uint32_t get_layout_channels(eChannelLayout layout)
+{
+	ASSERT(layout < eChannelLayout::kCount);
+	return kLayoutChannels[static_cast<uint32_t>(layout)];
+}
+
+eChannelLayout get_channel_layout(uint32_t numChannels)
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(eChannelLayout::kCount); ++i)
+	{
+		if (kLayoutChannels[i] == numChannels)
+		{
+			return static_cast<eChannelLayout>(i);
+		}
+	}
+	return eChannelLayout::kCount;
+}
+
+void make_layout_matrix(eChannelLayout inLayout, eChannelLayout outLayout, float* matrix)
+{
+	const uint32_t inChannels = get_layout_channels(inLayout);
+	const uint32_t outChannels = get_layout_channels(outLayout);
+	std::fill(matrix, matrix + inChannels * outChannels, 0.0f);
+
+	if (inLayout == outLayout)
+	{
+		for (uint32_t c = 0; c < inChannels; ++c)
+		{
+			matrix[c * inChannels + c] = 1.0f;
+		}
+	}
+	else if (outLayout == eChannelLayout::kStereo || outLayout == eChannelLayout::kMono)
+	{
+		// fold to stereo, mono sums the folded pair at -3dB.
+		const float (*fold)[2] = get_stereo_fold(inLayout);
+		for (uint32_t c = 0; c < inChannels; ++c)
+		{
+			if (outLayout == eChannelLayout::kStereo)
+			{
+				matrix[0 * inChannels + c] = fold[c][0];
+				matrix[1 * inChannels + c] = fold[c][1];
+			}
+			else
+			{
+				matrix[c] = kMinus3dB * (fold[c][0] + fold[c][1]);
+			}
+		}
+	}
+	else if (inLayout == eChannelLayout::kMono)
+	{
+		matrix[kCenter] = 1.0f;
+	}
+	else if (inLayout == eChannelLayout::kStereo)
+	{
+		matrix[0 * inChannels + 0] = 1.0f;
+		matrix[1 * inChannels + 1] = 1.0f;
+	}
+	else if (inLayout == eChannelLayout::k5_1)
+	{
+		// 5.1 to 7.1, the side pair stays silent.
+		for (uint32_t c = 0; c < inChannels; ++c)
+		{
+			matrix[c * inChannels + c] = 1.0f;
+		}
+	}
+	else
+	{
+		// 7.1 to 5.1, the back and side pairs share the 5.1 surrounds.
+		for (uint32_t c = 0; c < kBackLeft; ++c)
+		{
+			matrix[c * inChannels + c] = 1.0f;
+		}
+		for (uint32_t side = 0; side < 2; ++side)
+		{
+			matrix[(kBackLeft + side) * inChannels + kBackLeft + side] = kMinus3dB;
+			matrix[(kBackLeft + side) * inChannels + kSideLeft + side] = kMinus3dB;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ChannelMixer
+//////////////////////////////////////////////////////////////////////////
+ChannelMixer::ChannelMixer()
+	: m_numStreams{ 0 }
+	, m_outChannels{ 0 }
+	, m_maxFrames{ 0 }
+	, m_numInputPlanes{ 0 }
+	, m_streamChannels{ nullptr }
+	, m_firstPlane{ nullptr }
+	, m_inputPlanes{ nullptr }
+	, m_outputPlanes{ nullptr }
+	, m_matrix{ nullptr }
+	, m_routePlanes{ nullptr }
+	, m_routeGains{ nullptr }
+	, m_routeCounts{ nullptr }
+{}
+
+void ChannelMixer::init(uint32_t numStreams, const uint32_t* streamChannels, uint32_t outChannels, uint32_t maxFrames)
+{
+	ASSERT(numStreams > 0 && outChannels > 0);
+
+	m_numStreams = numStreams;
+	m_outChannels = outChannels;
+	m_maxFrames = maxFrames;
+	m_numInputPlanes = 0;
+	for (uint32_t s = 0; s < numStreams; ++s)
+	{
+		m_numInputPlanes += streamChannels[s];
+	}
+
+	const size_t planeBytes = AlignedArena::aligned_size(static_cast<size_t>(maxFrames) * sizeof(float));
+	const size_t routeSlots = static_cast<size_t>(outChannels) * m_numInputPlanes;
+	m_arena.init(AlignedArena::aligned_size(numStreams * sizeof(uint32_t)) * 2
+		+ AlignedArena::aligned_size(m_numInputPlanes * sizeof(float*))
+		+ AlignedArena::aligned_size(outChannels * sizeof(float*))
+		+ planeBytes * (m_numInputPlanes + outChannels)
+		+ AlignedArena::aligned_size(routeSlots * sizeof(float)) * 2
+		+ AlignedArena::aligned_size(routeSlots * sizeof(float*))
+		+ AlignedArena::aligned_size(outChannels * sizeof(uint32_t)));
+
+	m_streamChannels = m_arena.allocate_array<uint32_t>(numStreams);
+	m_firstPlane = m_arena.allocate_array<uint32_t>(numStreams);
+	uint32_t plane = 0;
+	for (uint32_t s = 0; s < numStreams; ++s)
+	{
+		m_streamChannels[s] = streamChannels[s];
+		m_firstPlane[s] = plane;
+		plane += streamChannels[s];
+	}
+
+	// every plane gets its own cache line aligned block.
+	m_inputPlanes = m_arena.allocate_array<float*>(m_numInputPlanes);
+	for (uint32_t p = 0; p < m_numInputPlanes; ++p)
+	{
+		m_inputPlanes[p] = m_arena.allocate_array<float>(maxFrames);
+	}
+	m_outputPlanes = m_arena.allocate_array<float*>(outChannels);
+	for (uint32_t o = 0; o < outChannels; ++o)
+	{
+		m_outputPlanes[o] = m_arena.allocate_array<float>(maxFrames);
+	}
+
+	m_matrix = m_arena.allocate_array<float>(routeSlots);
+	std::fill(m_matrix, m_matrix + routeSlots, 0.0f);
+	m_routePlanes = m_arena.allocate_array<const float*>(routeSlots);
+	m_routeGains = m_arena.allocate_array<float>(routeSlots);
+	m_routeCounts = m_arena.allocate_array<uint32_t>(outChannels);
+	build_routes();
+}
+
+void ChannelMixer::set_gain_matrix(uint32_t stream, const float* matrix)
+{
+	ASSERT(stream < m_numStreams);
+
+	const uint32_t inChannels = m_streamChannels[stream];
+	for (uint32_t o = 0; o < m_outChannels; ++o)
+	{
+		for (uint32_t i = 0; i < inChannels; ++i)
+		{
+			m_matrix[o * m_numInputPlanes + m_firstPlane[stream] + i] = matrix[o * inChannels + i];
+		}
+	}
+	build_routes();
+}
+
+void ChannelMixer::build_routes()
+{
+	for (uint32_t o = 0; o < m_outChannels; ++o)
+	{
+		const float* row = m_matrix + o * m_numInputPlanes;
+		const float** planes = m_routePlanes + o * m_numInputPlanes;
+		float* gains = m_routeGains + o * m_numInputPlanes;
+
+		uint32_t count = 0;
+		for (uint32_t p = 0; p < m_numInputPlanes; ++p)
+		{
+			if (row[p] != 0.0f)
+			{
+				planes[count] = m_inputPlanes[p];
+				gains[count] = row[p];
+				++count;
+			}
+		}
+		m_routeCounts[o] = count;
+	}
+}
+
+void ChannelMixer::mix(const float* const* ins, uint32_t numFrames)
+{
+	ASSERT(numFrames <= m_maxFrames);
+
+	{
+		TIMER_SCOPED_FINE("deinterleave");
+		for (uint32_t s = 0; s < m_numStreams; ++s)
+		{
+			WavAudio::deinterleave(ins[s], m_inputPlanes + m_firstPlane[s], m_streamChannels[s], numFrames);
+		}
+	}
+
+	// one pass and one store per output vector, however many planes feed it.
+	for (uint32_t o = 0; o < m_outChannels; ++o)
+	{
+		g_mixKernels.m_mixPlanes(m_routePlanes + o * m_numInputPlanes, m_routeGains + o * m_numInputPlanes, m_routeCounts[o], m_outputPlanes[o], numFrames);
+	}
+}
+
+} // namespace Mixer
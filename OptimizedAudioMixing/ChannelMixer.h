@@ -0,0 +1,78 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "AlignedArena.h"
+
+namespace Mixer {
+
+// Speaker layouts, channels in WAVE_FORMAT_EXTENSIBLE order.
+enum class eChannelLayout : uint32_t
+{
+	kMono,		// FC
+	kStereo,	// FL FR
+	k5_1,		// FL FR FC LFE BL BR
+	k7_1,		// FL FR FC LFE BL BR SL SR
+	kCount
+};
+
+uint32_t get_layout_channels(eChannelLayout layout);
+
+// Layout with this many channels, kCount if none matches.
+eChannelLayout get_channel_layout(uint32_t numChannels);
+
+// Fills an out x in row major matrix with the standard up/downmix between two layouts:
+// surrounds and center fold into the front pair at -3dB, LFE is dropped on downmix,
+// and upmixing only feeds the matching front (or center) channels.
+void make_layout_matrix(eChannelLayout inLayout, eChannelLayout outLayout, float* matrix);
+
+// Mixes streams of any channel count into any output layout.
+// Each stream is deinterleaved into 64 byte aligned planes and routed through its own
+// out x in gain matrix, so every output channel is one planar mix_planes pass over the
+// input planes that feed it. The output stays planar until the encoder interleaves it.
+class ChannelMixer
+{
+public:
+	ChannelMixer();
+
+	// streamChannels holds the interleaved channel count of each stream. Every gain starts at zero.
+	// Call once before mixing, sizes every buffer for blocks of up to maxFrames frames.
+	void init(uint32_t numStreams, const uint32_t* streamChannels, uint32_t outChannels, uint32_t maxFrames);
+
+	// matrix has outChannels rows of the stream's channel count,
+	// out[o] += in[i] * matrix[o * inChannels + i]. Not safe to call during mix.
+	void set_gain_matrix(uint32_t stream, const float* matrix);
+
+	// ins holds an interleaved block of numFrames frames per stream.
+	void mix(const float* const* ins, uint32_t numFrames);
+
+	// One plane per output channel, holding the last mix.
+	const float* const* get_output_planes() const { return m_outputPlanes; }
+	uint32_t get_out_channels() const { return m_outChannels; }
+
+private:
+	// Gathers the input planes with a non zero gain for each output channel.
+	void build_routes();
+
+	AlignedArena m_arena;
+
+	uint32_t m_numStreams;
+	uint32_t m_outChannels;
+	uint32_t m_maxFrames;
+	uint32_t m_numInputPlanes;	// sum of every stream's channels
+
+	uint32_t* m_streamChannels;	// per stream
+	uint32_t* m_firstPlane;		// per stream, index of its first input plane
+	float** m_inputPlanes;
+	float** m_outputPlanes;
+	float* m_matrix;			// out x m_numInputPlanes, every stream's matrix side by side
+
+	// per output channel, m_numInputPlanes slots of which m_routeCounts are used.
+	const float** m_routePlanes;
+	float* m_routeGains;
+	uint32_t* m_routeCounts;
+};
+
+} // namespace Mixer
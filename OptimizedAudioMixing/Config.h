@@ -10,3 +10,21 @@
 
 #define UNUSED(x) (void)(x);
 
+#define ALIGN16 alignas(16)
+#define ALIGN32 alignas(32)
+#define ALIGN64 alignas(64)
+
+
+// Instruction set targeting for individual kernel functions.
+// Every kernel variant is compiled into the same binary and picked at runtime,
+// so the widest paths must not rely on global /arch or -m flags.
+// MSVC will emit any intrinsic regardless of /arch, so these are empty there.
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define TARGET_SSSE3
+	#define TARGET_AVX2
+	#define TARGET_AVX512
+#else
+	#define TARGET_SSSE3 __attribute__((target("ssse3")))
+	#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+	#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,fma")))
+#endif
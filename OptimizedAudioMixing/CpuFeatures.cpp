@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+#endif
+
+namespace {
+
+void cpuid(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+	for (int i = 0; i < 4; ++i)
+	{
+		regs[i] = static_cast<uint32_t>(info[i]);
+	}
+#else
+	__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Reads the OS enabled register state (XCR0).
+uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+bool bit(uint32_t reg, uint32_t index)
+{
+	return (reg >> index) & 1u;
+}
+
+CpuFeatures detect_cpu_features()
+{
+	CpuFeatures features = { 0 };
+
+	uint32_t regs[4];	// eax, ebx, ecx, edx
+	cpuid(0, 0, regs);
+	const uint32_t maxLeaf = regs[0];
+	if (maxLeaf < 1)
+	{
+		return features;
+	}
+
+	cpuid(1, 0, regs);
+	features.m_sse2 = bit(regs[3], 26);
+	features.m_ssse3 = bit(regs[2], 9);
+	features.m_sse41 = bit(regs[2], 19);
+	const bool fma = bit(regs[2], 12);
+	const bool osxsave = bit(regs[2], 27);
+	const bool avx = bit(regs[2], 28);
+
+	// The wide registers are only usable if the OS saves them on a context switch.
+	const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+	const bool osYmm = (xcr0 & 0x06) == 0x06;		// xmm + ymm state
+	const bool osZmm = (xcr0 & 0xE6) == 0xE6;		// + opmask, zmm_hi256, hi16_zmm state
+
+	features.m_avx = avx && osYmm;
+	features.m_fma = fma && osYmm;
+
+	if (maxLeaf >= 7)
+	{
+		cpuid(7, 0, regs);
+		features.m_avx2 = bit(regs[1], 5) && osYmm;
+		features.m_avx512f = bit(regs[1], 16) && osZmm;
+		features.m_avx512bw = bit(regs[1], 30) && osZmm;
+	}
+
+	return features;
+}
+
+} // namespace
+
+const CpuFeatures& get_cpu_features()
+{
+	static const CpuFeatures sFeatures = detect_cpu_features();
+	return sFeatures;
+}
+
+void print_cpu_features(std::ostream& streamOut)
+{
+	const CpuFeatures& f = get_cpu_features();
+	streamOut
+		<< "\n\tsse2 " << f.m_sse2
+		<< "\n\tssse3 " << f.m_ssse3
+		<< "\n\tsse4.1 " << f.m_sse41
+		<< "\n\tavx " << f.m_avx
+		<< "\n\tavx2 " << f.m_avx2
+		<< "\n\tfma " << f.m_fma
+		<< "\n\tavx512f " << f.m_avx512f
+		<< "\n\tavx512bw " << f.m_avx512bw
+		<< "\n";
+}
+
+const char* get_kernel_isa_name(eKernelIsa isa)
+{
+	switch (isa)
+	{
+	case eKernelIsa::kScalar: return "scalar";
+	case eKernelIsa::kSSE: return "sse";
+	case eKernelIsa::kAVX2: return "avx2";
+	case eKernelIsa::kAVX512: return "avx512";
+	default: return "unknown";
+	}
+}
+
+bool is_kernel_isa_supported(eKernelIsa isa)
+{
+	const CpuFeatures& features = get_cpu_features();
+	switch (isa)
+	{
+	case eKernelIsa::kScalar: return true;
+	case eKernelIsa::kSSE: return features.m_sse2;
+	case eKernelIsa::kAVX2: return features.m_avx2 && features.m_fma;
+	case eKernelIsa::kAVX512: return features.m_avx512f && features.m_avx512bw && features.m_fma;
+	default: return false;
+	}
+}
+
+eKernelIsa get_best_kernel_isa()
+{
+	for (uint32_t i = static_cast<uint32_t>(eKernelIsa::kCount); i-- > 0;)
+	{
+		const eKernelIsa isa = static_cast<eKernelIsa>(i);
+		if (is_kernel_isa_supported(isa))
+		{
+			return isa;
+		}
+	}
+	return eKernelIsa::kScalar;
+}
@@ -0,0 +1,44 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <ostream>
+
+// Instruction set extensions we can dispatch on.
+// Each flag is only set when both the cpu and the OS (saved register state) support it.
+struct CpuFeatures
+{
+	bool m_sse2;
+	bool m_ssse3;
+	bool m_sse41;
+	bool m_avx;
+	bool m_avx2;
+	bool m_fma;
+	bool m_avx512f;
+	bool m_avx512bw;
+};
+
+// Queries cpuid on first call, then returns the cached result.
+const CpuFeatures& get_cpu_features();
+
+void print_cpu_features(std::ostream& streamOut);
+
+// Instruction set width of a kernel variant, narrowest first.
+enum class eKernelIsa : uint32_t
+{
+	kScalar,
+	kSSE,		// 128bit, sse2
+	kAVX2,		// 256bit, avx2 + fma
+	kAVX512,	// 512bit, avx512f + avx512bw + fma
+	kCount
+};
+
+const char* get_kernel_isa_name(eKernelIsa isa);
+
+// True if the host cpu can run kernels of this width.
+bool is_kernel_isa_supported(eKernelIsa isa);
+
+// Widest instruction set the host cpu supports.
+eKernelIsa get_best_kernel_isa();
@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "GainEnvelope.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Mixer {
+
+GainEnvelope::GainEnvelope(float gain)
+	: m_holdGain{ gain }
+{}
+
+void GainEnvelope::reset(float gain)
+{
+	m_holdGain = gain;
+	m_points.clear();
+}
+
+void GainEnvelope::add_point(uint64_t frame, float gain, eRampShape shape)
+{
+	ASSERT(m_points.empty() || m_points.back().m_frame <= frame);
+
+	if (!m_points.empty() && m_points.back().m_frame == frame)
+	{
+		m_points.back() = { frame, gain, shape };
+		return;
+	}
+	m_points.push_back({ frame, gain, shape });
+}
+
+size_t GainEnvelope::find_next_point(uint64_t frame) const
+{
+	return std::upper_bound(m_points.begin(), m_points.end(), frame, [](uint64_t f, const Point& point) {
+		return f < point.m_frame;
+	}) - m_points.begin();
+}
+
+float GainEnvelope::get_gain(uint64_t frame) const
+{
+	float start, step;
+	eRampShape shape;
+	get_ramp(frame, start, step, shape);
+	return start;
+}
+
+uint32_t GainEnvelope::get_segment_frames(uint64_t frame, uint32_t maxFrames) const
+{
+	const size_t next = find_next_point(frame);
+	if (next == m_points.size())
+	{
+		return maxFrames;
+	}
+	return static_cast<uint32_t>(std::min<uint64_t>(m_points[next].m_frame - frame, maxFrames));
+}
+
+void GainEnvelope::get_ramp(uint64_t frame, float& start, float& step, eRampShape& shape) const
+{
+	const size_t next = find_next_point(frame);
+	shape = eRampShape::kLinear;
+	step = 0.0f;
+
+	// hold before the first point and after the last.
+	if (next == m_points.size())
+	{
+		start = m_points.empty() ? m_holdGain : m_points.back().m_gain;
+		return;
+	}
+	if (next == 0)
+	{
+		start = m_points[0].m_gain;
+		return;
+	}
+
+	// the ramp is worked out from the segment's own ends, so it does not drift from block to block.
+	const Point& from = m_points[next - 1];
+	const Point& to = m_points[next];
+	const float length = static_cast<float>(to.m_frame - from.m_frame);
+	const float offset = static_cast<float>(frame - from.m_frame);
+	if (to.m_shape == eRampShape::kExponential && from.m_gain > 0.0f && to.m_gain > 0.0f)
+	{
+		shape = eRampShape::kExponential;
+		step = std::pow(to.m_gain / from.m_gain, 1.0f / length);
+		start = from.m_gain * std::pow(to.m_gain / from.m_gain, offset / length);
+	}
+	else
+	{
+		step = (to.m_gain - from.m_gain) / length;
+		start = from.m_gain + step * offset;
+	}
+}
+
+void mix_streams_automated(const float* const* ins, const GainEnvelope* envelopes, uint32_t numStreams, float* out, uint64_t firstFrame, uint32_t numFrames)
+{
+	ASSERT(numStreams <= kMaxAutomatedStreams);
+
+	const float* pieceIns[kMaxAutomatedStreams];
+	GainRamp ramps[kMaxAutomatedStreams];
+
+	for (uint32_t done = 0; done < numFrames;)
+	{
+		// the piece ends at the nearest breakpoint of any channel.
+		const uint64_t frame = firstFrame + done;
+		uint32_t pieceFrames = numFrames - done;
+		for (uint32_t e = 0; e < numStreams * 2; ++e)
+		{
+			pieceFrames = envelopes[e].get_segment_frames(frame, pieceFrames);
+		}
+
+		for (uint32_t s = 0; s < numStreams; ++s)
+		{
+			pieceIns[s] = ins[s] + done * 2;
+			for (uint32_t c = 0; c < 2; ++c)
+			{
+				envelopes[s * 2 + c].get_ramp(frame, ramps[s].m_start[c], ramps[s].m_step[c], ramps[s].m_shape[c]);
+			}
+		}
+
+		g_mixKernels.m_mixStreamsRamp(pieceIns, ramps, numStreams, out + done * 2, pieceFrames * 2);
+		done += pieceFrames;
+	}
+}
+
+} // namespace Mixer
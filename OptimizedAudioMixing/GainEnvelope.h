@@ -0,0 +1,59 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "MixKernels.h"
+#include <vector>
+
+namespace Mixer {
+
+// Most streams mix_streams_automated takes in one call.
+constexpr uint32_t kMaxAutomatedStreams = 256;
+
+// Breakpoint gain automation for one channel.
+// Each point sets the gain on a frame, the gain moves towards it from the previous point
+// along the point's shape and holds before the first point and after the last.
+class GainEnvelope
+{
+public:
+	// Starts as a constant gain with no points.
+	explicit GainEnvelope(float gain = 1.0f);
+
+	// Drops every point and holds gain.
+	void reset(float gain);
+
+	// Points must be added in frame order, a point on the same frame as the last replaces it.
+	void add_point(uint64_t frame, float gain, eRampShape shape = eRampShape::kLinear);
+
+	float get_gain(uint64_t frame) const;
+
+	// Frames from frame up to the next point, at most maxFrames. The gain follows a single
+	// ramp over them.
+	uint32_t get_segment_frames(uint64_t frame, uint32_t maxFrames) const;
+
+	// Start gain, per frame step and shape of the ramp that frame is on, as GainRamp holds them.
+	void get_ramp(uint64_t frame, float& start, float& step, eRampShape& shape) const;
+
+private:
+	struct Point
+	{
+		uint64_t m_frame;
+		float m_gain;
+		eRampShape m_shape;	// of the segment that ends on this point
+	};
+
+	// Index of the first point after frame, m_points.size() past the last one.
+	size_t find_next_point(uint64_t frame) const;
+
+	float m_holdGain;	// gain with no points
+	std::vector<Point> m_points;
+};
+
+// Mixes numStreams stereo blocks of numFrames frames into out, overwriting it, each stream
+// following its Left/Right pair in envelopes from frame firstFrame on. The block is cut at
+// every breakpoint any envelope has inside it and each piece is one mix_streams_ramp pass.
+void mix_streams_automated(const float* const* ins, const GainEnvelope* envelopes, uint32_t numStreams, float* out, uint64_t firstFrame, uint32_t numFrames);
+
+} // namespace Mixer
@@ -0,0 +1,164 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#if defined _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_data{ nullptr }
+	, m_size{ 0 }
+#if defined _WIN32
+	, m_fileHandle{ INVALID_HANDLE_VALUE }
+	, m_mappingHandle{ nullptr }
+#else
+	, m_fileDescriptor{ -1 }
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined _WIN32
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	m_fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mappingHandle == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+bool get_file_stamp(const char* filename, FileStamp& stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes))
+	{
+		return false;
+	}
+
+	stamp.m_size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	stamp.m_writeTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = nullptr;
+	}
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	m_fileDescriptor = ::open(filename, O_RDONLY);
+	if (m_fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo;
+	if (fstat(m_fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	// We stream front to back, let the kernel read ahead aggressively.
+	madvise(mapping, static_cast<size_t>(fileInfo.st_size), MADV_SEQUENTIAL);
+
+	m_data = static_cast<const uint8_t*>(mapping);
+	m_size = static_cast<size_t>(fileInfo.st_size);
+	return true;
+}
+
+bool get_file_stamp(const char* filename, FileStamp& stamp)
+{
+	struct stat fileInfo;
+	if (stat(filename, &fileInfo) != 0)
+	{
+		return false;
+	}
+
+	stamp.m_size = static_cast<uint64_t>(fileInfo.st_size);
+	stamp.m_writeTime = static_cast<uint64_t>(fileInfo.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(fileInfo.st_mtim.tv_nsec);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+		m_data = nullptr;
+	}
+	if (m_fileDescriptor >= 0)
+	{
+		::close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+	m_size = 0;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <cstddef>
+
+// Size and last write time of a file, enough to tell whether it changed since an earlier look
+// without reading it.
+struct FileStamp
+{
+	uint64_t m_size;
+	uint64_t m_writeTime;	// platform units, only compared for equality
+};
+
+// Returns false if the file does not exist or could not be queried.
+bool get_file_stamp(const char* filename, FileStamp& stamp);
+
+// Read only memory mapping of a whole file.
+// Pages are faulted in straight from the OS page cache, no copies are made.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	// Maps the file, returns false if it could not be opened or mapped.
+	bool open(const char* filename);
+
+	void close();
+
+	bool is_open() const { return m_data != nullptr; }
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const uint8_t* m_data;	// start of the mapped view
+	size_t m_size;			// size of the file in bytes
+
+#if defined _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fileDescriptor;
+#endif
+};
@@ -0,0 +1,1026 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "MixKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <immintrin.h>
+
+namespace Mixer {
+
+//////////////////////////////////////////////////////////////////////////
+// Fused multi-stream mixing.
+// Each width provides a kernel per group size, mix_stream_groups splits the
+// stream count into the widest groups available. The first group overwrites
+// the output, later groups accumulate into it.
+//////////////////////////////////////////////////////////////////////////
+typedef void (*MixGroupFunc)(const float* const* ins, const float* gains, float* out, uint32_t blockSize, bool accumulate);
+
+// Group sizes we have kernels for, widest first.
+constexpr uint32_t kGroupSizes[] = { 16, 8, 4, 2, 1 };
+constexpr uint32_t kNumGroupSizes = sizeof(kGroupSizes) / sizeof(kGroupSizes[0]);
+
+void mix_stream_groups(const MixGroupFunc (&groups)[kNumGroupSizes], const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	if (numStreams == 0)
+	{
+		std::fill(out, out + blockSize, 0.0f);
+		return;
+	}
+
+	bool accumulate = false;
+	for (uint32_t stream = 0; stream < numStreams;)
+	{
+		uint32_t group = 0;
+		while (kGroupSizes[group] > numStreams - stream)
+		{
+			++group;
+		}
+
+		groups[group](ins + stream, gains + stream * 2, out, blockSize, accumulate);
+		stream += kGroupSizes[group];
+		accumulate = true;
+	}
+}
+
+// Scalar remainder of a group once the vector loop is done, [start, blockSize).
+inline void mix_group_tail(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t start, uint32_t blockSize, bool accumulate)
+{
+	for (uint32_t i = start; i < blockSize; ++i)
+	{
+		const uint32_t channel = i & 1;
+		float acc = accumulate ? out[i] : 0.0f;
+		for (uint32_t s = 0; s < numStreams; ++s)
+		{
+			acc += ins[s][i] * gains[s * 2 + channel];
+		}
+		out[i] = acc;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Gain ramps.
+// Lane i of a vector is channel i & 1 of frame i / 2, so moving a vector on by
+// one pass advances every lane by half the width in frames, gain * scale + offset.
+// Linear ramps have a scale of 1, exponential ones an offset of 0. Every stream
+// keeps three vectors live, so the ramped groups are narrower.
+//////////////////////////////////////////////////////////////////////////
+typedef void (*MixRampGroupFunc)(const float* const* ins, const GainRamp* ramps, float* out, uint32_t blockSize, bool accumulate);
+
+constexpr uint32_t kRampGroupSizes[] = { 4, 2, 1 };
+constexpr uint32_t kNumRampGroupSizes = sizeof(kRampGroupSizes) / sizeof(kRampGroupSizes[0]);
+
+void mix_ramp_groups(const MixRampGroupFunc (&groups)[kNumRampGroupSizes], const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	if (numStreams == 0)
+	{
+		std::fill(out, out + blockSize, 0.0f);
+		return;
+	}
+
+	bool accumulate = false;
+	for (uint32_t stream = 0; stream < numStreams;)
+	{
+		uint32_t group = 0;
+		while (kRampGroupSizes[group] > numStreams - stream)
+		{
+			++group;
+		}
+
+		groups[group](ins + stream, ramps + stream, out, blockSize, accumulate);
+		stream += kRampGroupSizes[group];
+		accumulate = true;
+	}
+}
+
+// Multiply-add that moves a ramp channel on by numFrames frames.
+inline void get_ramp_advance(const GainRamp& ramp, uint32_t channel, uint32_t numFrames, float& scale, float& offset)
+{
+	if (ramp.m_shape[channel] == eRampShape::kExponential)
+	{
+		scale = std::pow(ramp.m_step[channel], static_cast<float>(numFrames));
+		offset = 0.0f;
+	}
+	else
+	{
+		scale = 1.0f;
+		offset = ramp.m_step[channel] * numFrames;
+	}
+}
+
+// First gains and per pass advance of each lane for vectors numLanes wide.
+inline void get_ramp_lanes(const GainRamp& ramp, uint32_t numLanes, float* gains, float* scales, float* offsets)
+{
+	for (uint32_t lane = 0; lane < numLanes; ++lane)
+	{
+		gains[lane] = get_ramp_gain(ramp, lane & 1, lane / 2);
+		get_ramp_advance(ramp, lane & 1, numLanes / 2, scales[lane], offsets[lane]);
+	}
+}
+
+// Scalar remainder of a ramped group, [start, blockSize), gains worked out from the frame.
+inline void mix_ramp_tail(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t start, uint32_t blockSize, bool accumulate)
+{
+	for (uint32_t i = start; i < blockSize; ++i)
+	{
+		float acc = accumulate ? out[i] : 0.0f;
+		for (uint32_t s = 0; s < numStreams; ++s)
+		{
+			acc += ins[s][i] * get_ramp_gain(ramps[s], i & 1, i / 2);
+		}
+		out[i] = acc;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Fixed point 16 bit mixing.
+// A pair of streams is interleaved sample by sample so one multiply-add gives
+// in0 * gain0 + in1 * gain1 as 32 bits. Each pair sum is shifted down by
+// kPairShift so the accumulator keeps kAccumFractionBits below the output LSB
+// and still has room for kMaxMixStreams16 full scale streams.
+//////////////////////////////////////////////////////////////////////////
+constexpr int kPairShift = 8;
+constexpr int kAccumFractionBits = 15 - kPairShift;
+constexpr int32_t kAccumRound = 1 << (kAccumFractionBits - 1);
+
+inline int16_t saturate16(int32_t value)
+{
+	return static_cast<int16_t>(std::min(32767, std::max(-32768, value)));
+}
+
+// Left/Right gains of streams s and s + 1 in the order the interleaved samples need them,
+// gain0[l] gain1[l] gain0[r] gain1[r]. A missing second stream gets a zero gain.
+void pack_pair_gains(const int16_t* gains, uint32_t numStreams, uint64_t* pairGains)
+{
+	for (uint32_t s = 0; s < numStreams; s += 2)
+	{
+		const bool hasSecond = s + 1 < numStreams;
+		const uint16_t l0 = static_cast<uint16_t>(gains[s * 2]);
+		const uint16_t r0 = static_cast<uint16_t>(gains[s * 2 + 1]);
+		const uint16_t l1 = hasSecond ? static_cast<uint16_t>(gains[s * 2 + 2]) : 0;
+		const uint16_t r1 = hasSecond ? static_cast<uint16_t>(gains[s * 2 + 3]) : 0;
+		pairGains[s / 2] = static_cast<uint64_t>(l0) | static_cast<uint64_t>(l1) << 16 | static_cast<uint64_t>(r0) << 32 | static_cast<uint64_t>(r1) << 48;
+	}
+}
+
+// Scalar remainder once the vector loop is done, [start, blockSize).
+void mix_streams16_tail(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t start, uint32_t blockSize)
+{
+	for (uint32_t i = start; i < blockSize; ++i)
+	{
+		const uint32_t channel = i & 1;
+		int32_t acc = 0;
+		for (uint32_t s = 0; s < numStreams; s += 2)
+		{
+			int32_t pair = ins[s][i] * gains[s * 2 + channel];
+			if (s + 1 < numStreams)
+			{
+				pair += ins[s + 1][i] * gains[s * 2 + 2 + channel];
+			}
+			acc += pair >> kPairShift;
+		}
+		out[i] = saturate16((acc + kAccumRound) >> kAccumFractionBits);
+	}
+}
+
+// Scalar remainder of a planar mix, [start, numFrames).
+inline void mix_planes_tail(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t start, uint32_t numFrames)
+{
+	for (uint32_t i = start; i < numFrames; ++i)
+	{
+		float acc = 0.0f;
+		for (uint32_t p = 0; p < numPlanes; ++p)
+		{
+			acc += ins[p][i] * gains[p];
+		}
+		out[i] = acc;
+	}
+}
+
+// in * gain rounded back to 16 bits, the same rounding as pmulhrsw.
+inline int32_t mul_q15(int32_t sample, int32_t gain)
+{
+	return (sample * gain + 0x4000) >> 15;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar
+//////////////////////////////////////////////////////////////////////////
+void mix_buffer_scalar(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+{
+	for (uint32_t i = 0; i < (blockSize / 2); ++i)
+	{
+		uint32_t leftIndex = i * 2;
+		uint32_t rightIndex = i * 2 + 1;
+
+		out[leftIndex] += in[leftIndex] * leftGain;
+		out[rightIndex] += in[rightIndex] * rightGain;
+	}
+}
+
+template<uint32_t N>
+void mix_group_scalar(const float* const* ins, const float* gains, float* out, uint32_t blockSize, bool accumulate)
+{
+	mix_group_tail(ins, gains, N, out, 0, blockSize, accumulate);
+}
+
+const MixGroupFunc kMixGroupsScalar[] = { mix_group_scalar<16>, mix_group_scalar<8>, mix_group_scalar<4>, mix_group_scalar<2>, mix_group_scalar<1> };
+
+void mix_streams_scalar(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_stream_groups(kMixGroupsScalar, ins, gains, numStreams, out, blockSize);
+}
+
+void mix_planes_scalar(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t numFrames)
+{
+	mix_planes_tail(ins, gains, numPlanes, out, 0, numFrames);
+}
+
+// Peak of samples [start, count) folded into peak.
+inline float peak_tail(const float* in, uint32_t start, uint32_t count, float peak)
+{
+	for (uint32_t i = start; i < count; ++i)
+	{
+		peak = std::max(peak, std::fabs(in[i]));
+	}
+	return peak;
+}
+
+float peak_scalar(const float* in, uint32_t count)
+{
+	return peak_tail(in, 0, count, 0.0f);
+}
+
+template<uint32_t N>
+void mix_ramp_group_scalar(const float* const* ins, const GainRamp* ramps, float* out, uint32_t blockSize, bool accumulate)
+{
+	float gains[N][2], scales[N][2], offsets[N][2];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		get_ramp_lanes(ramps[s], 2, gains[s], scales[s], offsets[s]);
+	}
+
+	// a stereo frame per pass, advanced a frame at a time.
+	const uint32_t pairEnd = blockSize & ~1u;
+	for (uint32_t i = 0; i < pairEnd; i += 2)
+	{
+		float left = accumulate ? out[i] : 0.0f;
+		float right = accumulate ? out[i + 1] : 0.0f;
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			left += ins[s][i] * gains[s][0];
+			right += ins[s][i + 1] * gains[s][1];
+			gains[s][0] = gains[s][0] * scales[s][0] + offsets[s][0];
+			gains[s][1] = gains[s][1] * scales[s][1] + offsets[s][1];
+		}
+		out[i] = left;
+		out[i + 1] = right;
+	}
+
+	mix_ramp_tail(ins, ramps, N, out, pairEnd, blockSize, accumulate);
+}
+
+const MixRampGroupFunc kMixRampGroupsScalar[] = { mix_ramp_group_scalar<4>, mix_ramp_group_scalar<2>, mix_ramp_group_scalar<1> };
+
+void mix_buffer_ramp_scalar(const float* in, float* out, const GainRamp& ramp, uint32_t blockSize)
+{
+	mix_ramp_group_scalar<1>(&in, &ramp, out, blockSize & ~1u, true);
+}
+
+void mix_streams_ramp_scalar(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_ramp_groups(kMixRampGroupsScalar, ins, ramps, numStreams, out, blockSize);
+}
+
+void mix_buffer16_scalar(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize)
+{
+	for (uint32_t i = 0; i < (blockSize / 2); ++i)
+	{
+		uint32_t leftIndex = i * 2;
+		uint32_t rightIndex = i * 2 + 1;
+
+		out[leftIndex] = saturate16(out[leftIndex] + mul_q15(in[leftIndex], leftGain));
+		out[rightIndex] = saturate16(out[rightIndex] + mul_q15(in[rightIndex], rightGain));
+	}
+}
+
+void mix_streams16_scalar(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize)
+{
+	ASSERT(numStreams <= kMaxMixStreams16);
+	mix_streams16_tail(ins, gains, numStreams, out, 0, blockSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 128bit - no fma on older hosts so multiply then add.
+//////////////////////////////////////////////////////////////////////////
+void mix_buffer_sse(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+{
+	const __m128 gains_128 = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+
+	// 2 stereo samples per pass, out is the accumulator.
+	const uint32_t vectorEnd = blockSize & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 inputs_128 = _mm_loadu_ps(&in[i]);		//in1[l] in1[r] in2[l] in2[r]
+		__m128 outputs_128 = _mm_loadu_ps(&out[i]);
+		outputs_128 = _mm_add_ps(outputs_128, _mm_mul_ps(inputs_128, gains_128));
+		_mm_storeu_ps(&out[i], outputs_128);
+	}
+
+	// vectorEnd is even so the tail still starts on a left sample.
+	mix_buffer_scalar(in + vectorEnd, out + vectorEnd, leftGain, rightGain, blockSize - vectorEnd);
+}
+template<uint32_t N>
+void mix_group_sse(const float* const* ins, const float* gains, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m128 gains_128[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		gains_128[s] = _mm_setr_ps(gains[s * 2], gains[s * 2 + 1], gains[s * 2], gains[s * 2 + 1]);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 acc = accumulate ? _mm_loadu_ps(&out[i]) : _mm_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&ins[s][i]), gains_128[s]));
+		}
+		_mm_storeu_ps(&out[i], acc);
+	}
+
+	mix_group_tail(ins, gains, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixGroupFunc kMixGroupsSse[] = { mix_group_sse<16>, mix_group_sse<8>, mix_group_sse<4>, mix_group_sse<2>, mix_group_sse<1> };
+
+void mix_streams_sse(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_stream_groups(kMixGroupsSse, ins, gains, numStreams, out, blockSize);
+}
+
+void mix_planes_sse(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t numFrames)
+{
+	const uint32_t vectorEnd = numFrames & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 acc = _mm_setzero_ps();
+		for (uint32_t p = 0; p < numPlanes; ++p)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&ins[p][i]), _mm_set1_ps(gains[p])));
+		}
+		_mm_storeu_ps(&out[i], acc);
+	}
+
+	mix_planes_tail(ins, gains, numPlanes, out, vectorEnd, numFrames);
+}
+
+float peak_sse(const float* in, uint32_t count)
+{
+	// clearing the sign bit gives the absolute value.
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 peak_128 = _mm_setzero_ps();
+	const uint32_t vectorEnd = count & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		peak_128 = _mm_max_ps(peak_128, _mm_and_ps(_mm_loadu_ps(&in[i]), absMask));
+	}
+
+	peak_128 = _mm_max_ps(peak_128, _mm_movehl_ps(peak_128, peak_128));
+	peak_128 = _mm_max_ss(peak_128, _mm_shuffle_ps(peak_128, peak_128, 1));
+	return peak_tail(in, vectorEnd, count, _mm_cvtss_f32(peak_128));
+}
+
+template<uint32_t N>
+void mix_ramp_group_sse(const float* const* ins, const GainRamp* ramps, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m128 gains_128[N], scales_128[N], offsets_128[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		float gains[4], scales[4], offsets[4];
+		get_ramp_lanes(ramps[s], 4, gains, scales, offsets);
+		gains_128[s] = _mm_loadu_ps(gains);
+		scales_128[s] = _mm_loadu_ps(scales);
+		offsets_128[s] = _mm_loadu_ps(offsets);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 acc = accumulate ? _mm_loadu_ps(&out[i]) : _mm_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&ins[s][i]), gains_128[s]));
+			gains_128[s] = _mm_add_ps(_mm_mul_ps(gains_128[s], scales_128[s]), offsets_128[s]);
+		}
+		_mm_storeu_ps(&out[i], acc);
+	}
+
+	mix_ramp_tail(ins, ramps, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixRampGroupFunc kMixRampGroupsSse[] = { mix_ramp_group_sse<4>, mix_ramp_group_sse<2>, mix_ramp_group_sse<1> };
+
+void mix_buffer_ramp_sse(const float* in, float* out, const GainRamp& ramp, uint32_t blockSize)
+{
+	mix_ramp_group_sse<1>(&in, &ramp, out, blockSize & ~1u, true);
+}
+
+void mix_streams_ramp_sse(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_ramp_groups(kMixRampGroupsSse, ins, ramps, numStreams, out, blockSize);
+}
+
+// pmulhrsw needs ssse3, so the 128bit kernel widens with pmaddwd against a zero and rounds by hand.
+void mix_buffer16_sse(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize)
+{
+	const __m128i gains_128 = _mm_setr_epi16(leftGain, 0, rightGain, 0, leftGain, 0, rightGain, 0);
+	const __m128i round_128 = _mm_set1_epi32(0x4000);
+	const __m128i zero_128 = _mm_setzero_si128();
+
+	// 4 stereo samples per pass.
+	const uint32_t vectorEnd = blockSize & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		const __m128i inputs_128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[i]));
+		__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(inputs_128, zero_128), gains_128);
+		__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(inputs_128, zero_128), gains_128);
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, round_128), 15);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, round_128), 15);
+
+		const __m128i outputs_128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&out[i]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm_adds_epi16(outputs_128, _mm_packs_epi32(lo, hi)));
+	}
+
+	mix_buffer16_scalar(in + vectorEnd, out + vectorEnd, leftGain, rightGain, blockSize - vectorEnd);
+}
+
+void mix_streams16_sse(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize)
+{
+	ASSERT(numStreams <= kMaxMixStreams16);
+	uint64_t pairGains[kMaxMixStreams16 / 2];
+	pack_pair_gains(gains, numStreams, pairGains);
+
+	const __m128i round_128 = _mm_set1_epi32(kAccumRound);
+	const __m128i zero_128 = _mm_setzero_si128();
+
+	// 8 samples per pass, the pair's samples are interleaved so pmaddwd sums them.
+	const uint32_t vectorEnd = blockSize & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m128i accLo = _mm_setzero_si128();
+		__m128i accHi = _mm_setzero_si128();
+		for (uint32_t s = 0; s < numStreams; s += 2)
+		{
+			const __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ins[s][i]));
+			const __m128i in1 = s + 1 < numStreams ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(&ins[s + 1][i])) : zero_128;
+			const __m128i gains_128 = _mm_set1_epi64x(static_cast<long long>(pairGains[s / 2]));
+
+			accLo = _mm_add_epi32(accLo, _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(in0, in1), gains_128), kPairShift));
+			accHi = _mm_add_epi32(accHi, _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(in0, in1), gains_128), kPairShift));
+		}
+
+		accLo = _mm_srai_epi32(_mm_add_epi32(accLo, round_128), kAccumFractionBits);
+		accHi = _mm_srai_epi32(_mm_add_epi32(accHi, round_128), kAccumFractionBits);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm_packs_epi32(accLo, accHi));
+	}
+
+	mix_streams16_tail(ins, gains, numStreams, out, vectorEnd, blockSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 256bit
+//////////////////////////////////////////////////////////////////////////
+TARGET_AVX2 void mix_buffer_avx2(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+{
+	const int gainsMask = 0xAA;													//mask of 01010101
+	__m256 gains_256 = _mm256_set1_ps(leftGain);								//splat left gain to all elements
+	gains_256 = _mm256_blend_ps(gains_256, _mm256_set1_ps(rightGain), gainsMask);	//load alternating values using the mask
+
+	// Only whole stereo pairs are mixed, like the scalar kernel.
+	const uint32_t numSamples = blockSize & ~1u;
+
+	// 4 stereo samples per pass, out is the fma accumulator.
+	const uint32_t vectorEnd = numSamples & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 inputs_256 = _mm256_loadu_ps(&in[i]);		//in1[l] in1[r] ... in4[l] in4[r]
+		__m256 outputs_256 = _mm256_loadu_ps(&out[i]);
+		outputs_256 = _mm256_fmadd_ps(inputs_256, gains_256, outputs_256);
+		_mm256_storeu_ps(&out[i], outputs_256);
+	}
+
+	// Masked tail, lanes past the end are neither read nor written.
+	const uint32_t remaining = numSamples - vectorEnd;
+	if (remaining > 0)
+	{
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(remaining)), lanes);
+
+		__m256 inputs_256 = _mm256_maskload_ps(&in[vectorEnd], mask);
+		__m256 outputs_256 = _mm256_maskload_ps(&out[vectorEnd], mask);
+		outputs_256 = _mm256_fmadd_ps(inputs_256, gains_256, outputs_256);
+		_mm256_maskstore_ps(&out[vectorEnd], mask, outputs_256);
+	}
+}
+template<uint32_t N>
+TARGET_AVX2 void mix_group_avx2(const float* const* ins, const float* gains, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m256 gains_256[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		const float l = gains[s * 2];
+		const float r = gains[s * 2 + 1];
+		gains_256[s] = _mm256_setr_ps(l, r, l, r, l, r, l, r);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 acc = accumulate ? _mm256_loadu_ps(&out[i]) : _mm256_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm256_fmadd_ps(_mm256_loadu_ps(&ins[s][i]), gains_256[s], acc);
+		}
+		_mm256_storeu_ps(&out[i], acc);
+	}
+
+	mix_group_tail(ins, gains, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixGroupFunc kMixGroupsAvx2[] = { mix_group_avx2<16>, mix_group_avx2<8>, mix_group_avx2<4>, mix_group_avx2<2>, mix_group_avx2<1> };
+
+void mix_streams_avx2(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_stream_groups(kMixGroupsAvx2, ins, gains, numStreams, out, blockSize);
+}
+
+TARGET_AVX2 void mix_planes_avx2(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t numFrames)
+{
+	const uint32_t vectorEnd = numFrames & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 acc = _mm256_setzero_ps();
+		for (uint32_t p = 0; p < numPlanes; ++p)
+		{
+			acc = _mm256_fmadd_ps(_mm256_loadu_ps(&ins[p][i]), _mm256_broadcast_ss(&gains[p]), acc);
+		}
+		_mm256_storeu_ps(&out[i], acc);
+	}
+
+	mix_planes_tail(ins, gains, numPlanes, out, vectorEnd, numFrames);
+}
+
+TARGET_AVX2 float peak_avx2(const float* in, uint32_t count)
+{
+	// two accumulators so consecutive maxes do not wait on each other.
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 peak0 = _mm256_setzero_ps();
+	__m256 peak1 = _mm256_setzero_ps();
+	const uint32_t vectorEnd = count & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		peak0 = _mm256_max_ps(peak0, _mm256_and_ps(_mm256_loadu_ps(&in[i]), absMask));
+		peak1 = _mm256_max_ps(peak1, _mm256_and_ps(_mm256_loadu_ps(&in[i + 8]), absMask));
+	}
+
+	peak0 = _mm256_max_ps(peak0, peak1);
+	__m128 peak_128 = _mm_max_ps(_mm256_castps256_ps128(peak0), _mm256_extractf128_ps(peak0, 1));
+	peak_128 = _mm_max_ps(peak_128, _mm_movehl_ps(peak_128, peak_128));
+	peak_128 = _mm_max_ss(peak_128, _mm_shuffle_ps(peak_128, peak_128, 1));
+	return peak_tail(in, vectorEnd, count, _mm_cvtss_f32(peak_128));
+}
+
+template<uint32_t N>
+TARGET_AVX2 void mix_ramp_group_avx2(const float* const* ins, const GainRamp* ramps, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m256 gains_256[N], scales_256[N], offsets_256[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		float gains[8], scales[8], offsets[8];
+		get_ramp_lanes(ramps[s], 8, gains, scales, offsets);
+		gains_256[s] = _mm256_loadu_ps(gains);
+		scales_256[s] = _mm256_loadu_ps(scales);
+		offsets_256[s] = _mm256_loadu_ps(offsets);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 acc = accumulate ? _mm256_loadu_ps(&out[i]) : _mm256_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm256_fmadd_ps(_mm256_loadu_ps(&ins[s][i]), gains_256[s], acc);
+			gains_256[s] = _mm256_fmadd_ps(gains_256[s], scales_256[s], offsets_256[s]);
+		}
+		_mm256_storeu_ps(&out[i], acc);
+	}
+
+	mix_ramp_tail(ins, ramps, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixRampGroupFunc kMixRampGroupsAvx2[] = { mix_ramp_group_avx2<4>, mix_ramp_group_avx2<2>, mix_ramp_group_avx2<1> };
+
+void mix_buffer_ramp_avx2(const float* in, float* out, const GainRamp& ramp, uint32_t blockSize)
+{
+	mix_ramp_group_avx2<1>(&in, &ramp, out, blockSize & ~1u, true);
+}
+
+void mix_streams_ramp_avx2(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_ramp_groups(kMixRampGroupsAvx2, ins, ramps, numStreams, out, blockSize);
+}
+
+TARGET_AVX2 void mix_buffer16_avx2(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize)
+{
+	const __m256i gains_256 = _mm256_set1_epi32(static_cast<uint16_t>(leftGain) | static_cast<uint32_t>(static_cast<uint16_t>(rightGain)) << 16);
+
+	// 8 stereo samples per pass, pmulhrsw rounds the Q15 product and the add saturates.
+	const uint32_t vectorEnd = blockSize & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		const __m256i inputs_256 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in[i]));
+		const __m256i outputs_256 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&out[i]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), _mm256_adds_epi16(outputs_256, _mm256_mulhrs_epi16(inputs_256, gains_256)));
+	}
+
+	mix_buffer16_scalar(in + vectorEnd, out + vectorEnd, leftGain, rightGain, blockSize - vectorEnd);
+}
+
+// unpack and pack both work within 128bit lanes, so the samples come back out in order.
+TARGET_AVX2 void mix_streams16_avx2(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize)
+{
+	ASSERT(numStreams <= kMaxMixStreams16);
+	uint64_t pairGains[kMaxMixStreams16 / 2];
+	pack_pair_gains(gains, numStreams, pairGains);
+
+	const __m256i round_256 = _mm256_set1_epi32(kAccumRound);
+	const __m256i zero_256 = _mm256_setzero_si256();
+
+	const uint32_t vectorEnd = blockSize & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m256i accLo = _mm256_setzero_si256();
+		__m256i accHi = _mm256_setzero_si256();
+		for (uint32_t s = 0; s < numStreams; s += 2)
+		{
+			const __m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&ins[s][i]));
+			const __m256i in1 = s + 1 < numStreams ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&ins[s + 1][i])) : zero_256;
+			const __m256i gains_256 = _mm256_set1_epi64x(static_cast<long long>(pairGains[s / 2]));
+
+			accLo = _mm256_add_epi32(accLo, _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(in0, in1), gains_256), kPairShift));
+			accHi = _mm256_add_epi32(accHi, _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(in0, in1), gains_256), kPairShift));
+		}
+
+		accLo = _mm256_srai_epi32(_mm256_add_epi32(accLo, round_256), kAccumFractionBits);
+		accHi = _mm256_srai_epi32(_mm256_add_epi32(accHi, round_256), kAccumFractionBits);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), _mm256_packs_epi32(accLo, accHi));
+	}
+
+	mix_streams16_tail(ins, gains, numStreams, out, vectorEnd, blockSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 512bit
+//////////////////////////////////////////////////////////////////////////
+TARGET_AVX512 void mix_buffer_avx512(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize)
+{
+	const __mmask16 gainsMask = 0xAAAA;											//mask of 0101010101010101
+	__m512 gains_512 = _mm512_set1_ps(leftGain);								//splat left gain to all elements
+	gains_512 = _mm512_mask_blend_ps(gainsMask, gains_512, _mm512_set1_ps(rightGain));	//load alternating values using the mask
+
+	// Only whole stereo pairs are mixed, like the scalar kernel.
+	const uint32_t numSamples = blockSize & ~1u;
+
+	// 8 stereo samples per pass, out is the fma accumulator.
+	const uint32_t vectorEnd = numSamples & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 inputs_512 = _mm512_loadu_ps(&in[i]);		//in1[l] in1[r] ... in8[l] in8[r]
+		__m512 outputs_512 = _mm512_loadu_ps(&out[i]);
+		outputs_512 = _mm512_fmadd_ps(inputs_512, gains_512, outputs_512);
+		_mm512_storeu_ps(&out[i], outputs_512);
+	}
+
+	// Masked tail, lanes past the end are neither read nor written.
+	const uint32_t remaining = numSamples - vectorEnd;
+	if (remaining > 0)
+	{
+		const __mmask16 mask = static_cast<__mmask16>((1u << remaining) - 1);
+
+		__m512 inputs_512 = _mm512_maskz_loadu_ps(mask, &in[vectorEnd]);
+		__m512 outputs_512 = _mm512_maskz_loadu_ps(mask, &out[vectorEnd]);
+		outputs_512 = _mm512_fmadd_ps(inputs_512, gains_512, outputs_512);
+		_mm512_mask_storeu_ps(&out[vectorEnd], mask, outputs_512);
+	}
+}
+template<uint32_t N>
+TARGET_AVX512 void mix_group_avx512(const float* const* ins, const float* gains, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m512 gains_512[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		gains_512[s] = _mm512_set4_ps(gains[s * 2 + 1], gains[s * 2], gains[s * 2 + 1], gains[s * 2]);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 acc = accumulate ? _mm512_loadu_ps(&out[i]) : _mm512_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm512_fmadd_ps(_mm512_loadu_ps(&ins[s][i]), gains_512[s], acc);
+		}
+		_mm512_storeu_ps(&out[i], acc);
+	}
+
+	mix_group_tail(ins, gains, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixGroupFunc kMixGroupsAvx512[] = { mix_group_avx512<16>, mix_group_avx512<8>, mix_group_avx512<4>, mix_group_avx512<2>, mix_group_avx512<1> };
+
+void mix_streams_avx512(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_stream_groups(kMixGroupsAvx512, ins, gains, numStreams, out, blockSize);
+}
+
+TARGET_AVX512 void mix_planes_avx512(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t numFrames)
+{
+	const uint32_t vectorEnd = numFrames & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 acc = _mm512_setzero_ps();
+		for (uint32_t p = 0; p < numPlanes; ++p)
+		{
+			acc = _mm512_fmadd_ps(_mm512_loadu_ps(&ins[p][i]), _mm512_set1_ps(gains[p]), acc);
+		}
+		_mm512_storeu_ps(&out[i], acc);
+	}
+
+	// Masked tail, lanes past the end are neither read nor written.
+	const uint32_t remaining = numFrames - vectorEnd;
+	if (remaining > 0)
+	{
+		const __mmask16 mask = static_cast<__mmask16>((1u << remaining) - 1);
+		__m512 acc = _mm512_setzero_ps();
+		for (uint32_t p = 0; p < numPlanes; ++p)
+		{
+			acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &ins[p][vectorEnd]), _mm512_set1_ps(gains[p]), acc);
+		}
+		_mm512_mask_storeu_ps(&out[vectorEnd], mask, acc);
+	}
+}
+
+TARGET_AVX512 float peak_avx512(const float* in, uint32_t count)
+{
+	__m512 peak_512 = _mm512_setzero_ps();
+	const uint32_t vectorEnd = count & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		peak_512 = _mm512_max_ps(peak_512, _mm512_abs_ps(_mm512_loadu_ps(&in[i])));
+	}
+
+	// Masked tail, the lanes past the end load as zero.
+	const uint32_t remaining = count - vectorEnd;
+	if (remaining > 0)
+	{
+		const __mmask16 mask = static_cast<__mmask16>((1u << remaining) - 1);
+		peak_512 = _mm512_max_ps(peak_512, _mm512_abs_ps(_mm512_maskz_loadu_ps(mask, &in[vectorEnd])));
+	}
+	return _mm512_reduce_max_ps(peak_512);
+}
+
+template<uint32_t N>
+TARGET_AVX512 void mix_ramp_group_avx512(const float* const* ins, const GainRamp* ramps, float* out, uint32_t blockSize, bool accumulate)
+{
+	__m512 gains_512[N], scales_512[N], offsets_512[N];
+	for (uint32_t s = 0; s < N; ++s)
+	{
+		float gains[16], scales[16], offsets[16];
+		get_ramp_lanes(ramps[s], 16, gains, scales, offsets);
+		gains_512[s] = _mm512_loadu_ps(gains);
+		scales_512[s] = _mm512_loadu_ps(scales);
+		offsets_512[s] = _mm512_loadu_ps(offsets);
+	}
+
+	const uint32_t vectorEnd = blockSize & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 acc = accumulate ? _mm512_loadu_ps(&out[i]) : _mm512_setzero_ps();
+		for (uint32_t s = 0; s < N; ++s)
+		{
+			acc = _mm512_fmadd_ps(_mm512_loadu_ps(&ins[s][i]), gains_512[s], acc);
+			gains_512[s] = _mm512_fmadd_ps(gains_512[s], scales_512[s], offsets_512[s]);
+		}
+		_mm512_storeu_ps(&out[i], acc);
+	}
+
+	mix_ramp_tail(ins, ramps, N, out, vectorEnd, blockSize, accumulate);
+}
+
+const MixRampGroupFunc kMixRampGroupsAvx512[] = { mix_ramp_group_avx512<4>, mix_ramp_group_avx512<2>, mix_ramp_group_avx512<1> };
+
+void mix_buffer_ramp_avx512(const float* in, float* out, const GainRamp& ramp, uint32_t blockSize)
+{
+	mix_ramp_group_avx512<1>(&in, &ramp, out, blockSize & ~1u, true);
+}
+
+void mix_streams_ramp_avx512(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize)
+{
+	mix_ramp_groups(kMixRampGroupsAvx512, ins, ramps, numStreams, out, blockSize);
+}
+
+TARGET_AVX512 void mix_buffer16_avx512(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize)
+{
+	const __m512i gains_512 = _mm512_set1_epi32(static_cast<uint16_t>(leftGain) | static_cast<uint32_t>(static_cast<uint16_t>(rightGain)) << 16);
+
+	// 16 stereo samples per pass.
+	const uint32_t vectorEnd = blockSize & ~31u;
+	for (uint32_t i = 0; i < vectorEnd; i += 32)
+	{
+		const __m512i inputs_512 = _mm512_loadu_si512(&in[i]);
+		const __m512i outputs_512 = _mm512_loadu_si512(&out[i]);
+		_mm512_storeu_si512(&out[i], _mm512_adds_epi16(outputs_512, _mm512_mulhrs_epi16(inputs_512, gains_512)));
+	}
+
+	mix_buffer16_scalar(in + vectorEnd, out + vectorEnd, leftGain, rightGain, blockSize - vectorEnd);
+}
+
+TARGET_AVX512 void mix_streams16_avx512(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize)
+{
+	ASSERT(numStreams <= kMaxMixStreams16);
+	uint64_t pairGains[kMaxMixStreams16 / 2];
+	pack_pair_gains(gains, numStreams, pairGains);
+
+	const __m512i round_512 = _mm512_set1_epi32(kAccumRound);
+	const __m512i zero_512 = _mm512_setzero_si512();
+
+	const uint32_t vectorEnd = blockSize & ~31u;
+	for (uint32_t i = 0; i < vectorEnd; i += 32)
+	{
+		__m512i accLo = _mm512_setzero_si512();
+		__m512i accHi = _mm512_setzero_si512();
+		for (uint32_t s = 0; s < numStreams; s += 2)
+		{
+			const __m512i in0 = _mm512_loadu_si512(&ins[s][i]);
+			const __m512i in1 = s + 1 < numStreams ? _mm512_loadu_si512(&ins[s + 1][i]) : zero_512;
+			const __m512i gains_512 = _mm512_set1_epi64(static_cast<long long>(pairGains[s / 2]));
+
+			accLo = _mm512_add_epi32(accLo, _mm512_srai_epi32(_mm512_madd_epi16(_mm512_unpacklo_epi16(in0, in1), gains_512), kPairShift));
+			accHi = _mm512_add_epi32(accHi, _mm512_srai_epi32(_mm512_madd_epi16(_mm512_unpackhi_epi16(in0, in1), gains_512), kPairShift));
+		}
+
+		accLo = _mm512_srai_epi32(_mm512_add_epi32(accLo, round_512), kAccumFractionBits);
+		accHi = _mm512_srai_epi32(_mm512_add_epi32(accHi, round_512), kAccumFractionBits);
+		_mm512_storeu_si512(&out[i], _mm512_packs_epi32(accLo, accHi));
+	}
+
+	mix_streams16_tail(ins, gains, numStreams, out, vectorEnd, blockSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Registry
+//////////////////////////////////////////////////////////////////////////
+MixKernelTable g_mixKernels = { eKernelIsa::kScalar, mix_buffer_scalar, mix_streams_scalar, mix_planes_scalar, mix_buffer_ramp_scalar, mix_streams_ramp_scalar, mix_buffer16_scalar, mix_streams16_scalar, peak_scalar };
+
+MixKernelTable get_mix_kernels(eKernelIsa isa)
+{
+	switch (isa)
+	{
+	case eKernelIsa::kSSE: return { isa, mix_buffer_sse, mix_streams_sse, mix_planes_sse, mix_buffer_ramp_sse, mix_streams_ramp_sse, mix_buffer16_sse, mix_streams16_sse, peak_sse };
+	case eKernelIsa::kAVX2: return { isa, mix_buffer_avx2, mix_streams_avx2, mix_planes_avx2, mix_buffer_ramp_avx2, mix_streams_ramp_avx2, mix_buffer16_avx2, mix_streams16_avx2, peak_avx2 };
+	case eKernelIsa::kAVX512: return { isa, mix_buffer_avx512, mix_streams_avx512, mix_planes_avx512, mix_buffer_ramp_avx512, mix_streams_ramp_avx512, mix_buffer16_avx512, mix_streams16_avx512, peak_avx512 };
+	default: return { eKernelIsa::kScalar, mix_buffer_scalar, mix_streams_scalar, mix_planes_scalar, mix_buffer_ramp_scalar, mix_streams_ramp_scalar, mix_buffer16_scalar, mix_streams16_scalar, peak_scalar };
+	}
+}
+
+void bind_mix_kernels()
+{
+	g_mixKernels = get_mix_kernels(get_best_kernel_isa());
+}
+
+bool verify_mix_kernels16(std::ostream& streamOut)
+{
+	// Odd block size for the tails, an odd stream count for the unpaired stream, and
+	// full scale inputs with large gains to push the sums into saturation.
+	const uint32_t kNumSamples = 4096 + 13;
+	const uint32_t kNumStreams = 7;
+
+	std::vector<std::vector<int16_t>> inputs(kNumStreams, std::vector<int16_t>(kNumSamples));
+	std::vector<const int16_t*> ins(kNumStreams);
+	std::vector<int16_t> gains(kNumStreams * 2);
+	for (uint32_t s = 0; s < kNumStreams; ++s)
+	{
+		for (uint32_t i = 0; i < kNumSamples; ++i)
+		{
+			inputs[s][i] = static_cast<int16_t>((i + s * 977) * 2654435761u >> 16);
+		}
+		inputs[s][s] = -32768;
+		ins[s] = inputs[s].data();
+		gains[s * 2] = to_q15_gain(s & 1 ? -0.9f : 0.9f);
+		gains[s * 2 + 1] = to_q15_gain(0.3f - 0.2f * s);
+	}
+
+	const MixKernelTable reference = get_mix_kernels(eKernelIsa::kScalar);
+	std::vector<int16_t> expected(kNumSamples), actual(kNumSamples);
+
+	bool ok = true;
+	for (uint32_t i = 1; i < static_cast<uint32_t>(eKernelIsa::kCount); ++i)
+	{
+		const eKernelIsa isa = static_cast<eKernelIsa>(i);
+		if (!is_kernel_isa_supported(isa))
+		{
+			continue;
+		}
+
+		const MixKernelTable kernels = get_mix_kernels(isa);
+
+		std::copy(inputs[1].begin(), inputs[1].end(), expected.begin());
+		std::copy(inputs[1].begin(), inputs[1].end(), actual.begin());
+		reference.m_mixBuffer16(ins[0], expected.data(), gains[0], gains[1], kNumSamples);
+		kernels.m_mixBuffer16(ins[0], actual.data(), gains[0], gains[1], kNumSamples);
+		if (expected != actual)
+		{
+			streamOut << "mix_buffer16 " << get_kernel_isa_name(isa) << " differs from scalar" << std::endl;
+			ok = false;
+		}
+
+		reference.m_mixStreams16(ins.data(), gains.data(), kNumStreams, expected.data(), kNumSamples);
+		kernels.m_mixStreams16(ins.data(), gains.data(), kNumStreams, actual.data(), kNumSamples);
+		if (expected != actual)
+		{
+			streamOut << "mix_streams16 " << get_kernel_isa_name(isa) << " differs from scalar" << std::endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+//////////////////////////////////////////////////////////////////////////
+GainRamp make_gain_ramp(const float* startGains, const float* endGains, uint32_t numFrames, eRampShape shape)
+{
+	ASSERT(numFrames > 0);
+
+	GainRamp ramp;
+	for (uint32_t c = 0; c < 2; ++c)
+	{
+		ramp.m_start[c] = startGains[c];
+		if (shape == eRampShape::kExponential && startGains[c] > 0.0f && endGains[c] > 0.0f)
+		{
+			ramp.m_step[c] = std::pow(endGains[c] / startGains[c], 1.0f / numFrames);
+			ramp.m_shape[c] = eRampShape::kExponential;
+		}
+		else
+		{
+			ramp.m_step[c] = (endGains[c] - startGains[c]) / numFrames;
+			ramp.m_shape[c] = eRampShape::kLinear;
+		}
+	}
+	return ramp;
+}
+
+float get_ramp_gain(const GainRamp& ramp, uint32_t channel, uint32_t frame)
+{
+	if (ramp.m_shape[channel] == eRampShape::kExponential)
+	{
+		return ramp.m_start[channel] * std::pow(ramp.m_step[channel], static_cast<float>(frame));
+	}
+	return ramp.m_start[channel] + ramp.m_step[channel] * frame;
+}
+
+int16_t to_q15_gain(float gain)
+{
+	const float scaled = std::round(gain * 32768.0f);
+	return static_cast<int16_t>(std::min(32767.0f, std::max(-32767.0f, scaled)));
+}
+
+void to_q15_gains(const float* gains, int16_t* gainsQ15, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		gainsQ15[i] = to_q15_gain(gains[i]);
+	}
+}
+
+void clear_buffer(float* out, uint32_t blockSize)
+{
+	for (uint32_t i = 0; i < blockSize; ++i)
+	{
+		out[i] = 0;
+	}
+}
+
+void clear_buffer16(int16_t* out, uint32_t blockSize)
+{
+	for (uint32_t i = 0; i < blockSize; ++i)
+	{
+		out[i] = 0;
+	}
+}
+
+} // namespace Mixer
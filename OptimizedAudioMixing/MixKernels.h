@@ -0,0 +1,108 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "CpuFeatures.h"
+#include <ostream>
+
+namespace Mixer {
+
+// Mixes a stereo interleaved block into an accumulation buffer.
+typedef void (*MixBufferFunc)(const float* in, float* out, float leftGain, float rightGain, uint32_t blockSize);
+
+// Mixes numStreams stereo interleaved blocks straight into out, overwriting it.
+// gains holds a Left/Right pair per stream. Each output vector is stored once,
+// all inputs are accumulated in registers first.
+typedef void (*MixStreamsFunc)(const float* const* ins, const float* gains, uint32_t numStreams, float* out, uint32_t blockSize);
+
+// Mixes numPlanes single channel (planar) blocks straight into out, overwriting it,
+// out[i] = sum of ins[p][i] * gains[p]. Any frame count, every lane is the same channel.
+typedef void (*MixPlanesFunc)(const float* const* ins, const float* gains, uint32_t numPlanes, float* out, uint32_t numFrames);
+
+// Largest absolute value of count samples, used to find silent blocks. Any count.
+typedef float (*PeakFunc)(const float* in, uint32_t count);
+
+// How a gain moves across a ramp.
+enum class eRampShape : uint32_t
+{
+	kLinear,		// gain(f) = start + f * step
+	kExponential,	// gain(f) = start * step^f, a constant dB change per frame
+};
+
+// Left/Right gains of one stereo stream changing frame by frame across a block.
+// Kernels keep a vector of gains and advance it with one multiply-add per pass,
+// so a ramp costs one extra fma per stream per vector over constant gains.
+struct GainRamp
+{
+	float m_start[2];	// gains of frame 0
+	float m_step[2];	// per frame increment (linear) or ratio (exponential)
+	eRampShape m_shape[2];
+};
+
+// Ramp from startGains on frame 0 to endGains on frame numFrames, the first frame of the next block.
+// Exponential ramps need both ends above zero and fall back to linear otherwise.
+GainRamp make_gain_ramp(const float* startGains, const float* endGains, uint32_t numFrames, eRampShape shape);
+
+// Gain of a ramp channel on a frame.
+float get_ramp_gain(const GainRamp& ramp, uint32_t channel, uint32_t frame);
+
+// mix_buffer with gains following a ramp, accumulates into out.
+typedef void (*MixBufferRampFunc)(const float* in, float* out, const GainRamp& ramp, uint32_t blockSize);
+
+// mix_streams with a ramp per stream, overwrites out.
+typedef void (*MixStreamsRampFunc)(const float* const* ins, const GainRamp* ramps, uint32_t numStreams, float* out, uint32_t blockSize);
+
+// Fixed point 16 bit kernels, gains are Q15 (see to_q15_gain).
+// Mixes a stereo interleaved block into an accumulation buffer, each product is rounded
+// and the add saturates instead of wrapping.
+typedef void (*MixBuffer16Func)(const int16_t* in, int16_t* out, int16_t leftGain, int16_t rightGain, uint32_t blockSize);
+
+// Mixes numStreams stereo interleaved 16 bit blocks straight into out, overwriting it.
+// Streams are multiplied in pairs into 32 bit accumulators, which keep 7 fractional bits,
+// and the sum is rounded and saturated once when packed back to 16 bits. Every width
+// gives bit identical results.
+typedef void (*MixStreams16Func)(const int16_t* const* ins, const int16_t* gains, uint32_t numStreams, int16_t* out, uint32_t blockSize);
+
+// Most streams a MixStreams16Func accepts in one call.
+constexpr uint32_t kMaxMixStreams16 = 256;
+
+// One set of mixing kernels, all built for the same instruction set.
+struct MixKernelTable
+{
+	eKernelIsa m_isa;
+	MixBufferFunc m_mixBuffer;
+	MixStreamsFunc m_mixStreams;
+	MixPlanesFunc m_mixPlanes;
+	MixBufferRampFunc m_mixBufferRamp;
+	MixStreamsRampFunc m_mixStreamsRamp;
+	MixBuffer16Func m_mixBuffer16;
+	MixStreams16Func m_mixStreams16;
+	PeakFunc m_peak;
+};
+
+// Kernel table for a specific width, whether or not the host can run it.
+MixKernelTable get_mix_kernels(eKernelIsa isa);
+
+// Detects cpu features and binds the widest supported kernels into g_mixKernels.
+// Call once at startup before mixing, until then the scalar kernels are bound.
+void bind_mix_kernels();
+
+// Checks the fixed point kernels of every width the host supports bit for bit against
+// the scalar ones. Returns false and reports the first mismatch if any differ.
+bool verify_mix_kernels16(std::ostream& streamOut);
+
+// The kernels bound for this host.
+extern MixKernelTable g_mixKernels;
+
+// Converts a float gain to Q15, rounded and clamped to [-32767, 32767] so a full
+// scale sample times a gain never overflows 16 bits.
+int16_t to_q15_gain(float gain);
+void to_q15_gains(const float* gains, int16_t* gainsQ15, uint32_t count);
+
+// Clears a buffer to zero.
+void clear_buffer(float* out, uint32_t blockSize);
+void clear_buffer16(int16_t* out, uint32_t blockSize);
+
+} // namespace Mixer
@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "MixerContext.h"
+
+namespace Mixer {
+
+MixerContext::MixerContext()
+	: m_blockSize{ 0 }
+	, m_scratchBytes{ 0 }
+	, m_inputs{ nullptr }
+	, m_output{ nullptr }
+	, m_inputs16{ nullptr }
+	, m_output16{ nullptr }
+	, m_scratch{ nullptr }
+{}
+
+void MixerContext::init(uint32_t blockSize, uint32_t numStreams, uint32_t numScratch, uint32_t scratchBytes)
+{
+	// keep every scratch block on its own aligned boundary.
+	scratchBytes = static_cast<uint32_t>(AlignedArena::aligned_size(scratchBytes));
+
+	const size_t inputBytes = static_cast<size_t>(blockSize) * numStreams * sizeof(float);
+	const size_t outputBytes = static_cast<size_t>(blockSize) * sizeof(float);
+	const size_t inputs16Bytes = static_cast<size_t>(blockSize) * numStreams * sizeof(int16_t);
+	const size_t output16Bytes = static_cast<size_t>(blockSize) * sizeof(int16_t);
+	const size_t scratchTotal = static_cast<size_t>(numScratch) * scratchBytes;
+
+	m_arena.init(AlignedArena::aligned_size(inputBytes)
+		+ AlignedArena::aligned_size(outputBytes)
+		+ AlignedArena::aligned_size(inputs16Bytes)
+		+ AlignedArena::aligned_size(output16Bytes)
+		+ AlignedArena::aligned_size(scratchTotal));
+
+	m_blockSize = blockSize;
+	m_scratchBytes = scratchBytes;
+
+	m_inputs = m_arena.allocate_array<float>(static_cast<size_t>(blockSize) * numStreams);
+	m_output = m_arena.allocate_array<float>(blockSize);
+	m_inputs16 = m_arena.allocate_array<int16_t>(static_cast<size_t>(blockSize) * numStreams);
+	m_output16 = m_arena.allocate_array<int16_t>(blockSize);
+	m_scratch = m_arena.allocate_array<uint8_t>(scratchTotal);
+}
+
+} // namespace Mixer
@@ -0,0 +1,50 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "AlignedArena.h"
+
+namespace Mixer {
+
+// Owns every per block buffer the mixer needs.
+// All of them are carved out of one 64 byte aligned arena, sized once from the
+// block size and reused for every block.
+class MixerContext
+{
+public:
+	MixerContext();
+
+	// Sizes the arena for blockSize sample blocks of numStreams inputs, plus
+	// numScratch file scratch buffers of scratchBytes each. Call once before mixing.
+	void init(uint32_t blockSize, uint32_t numStreams, uint32_t numScratch, uint32_t scratchBytes);
+
+	uint32_t get_block_size() const { return m_blockSize; }
+
+	// Float input block for one stream.
+	float* get_inputs(uint32_t stream) const { return m_inputs + static_cast<size_t>(stream) * m_blockSize; }
+	float* get_output() const { return m_output; }
+
+	// 16 bit mixing blocks, an input block per stream.
+	int16_t* get_inputs16(uint32_t stream) const { return m_inputs16 + static_cast<size_t>(stream) * m_blockSize; }
+	int16_t* get_output16() const { return m_output16; }
+
+	// Scratch memory for a file's encode/decode, see WavAudioFile::set_scratch_memory.
+	uint8_t* get_scratch(uint32_t index) const { return m_scratch + static_cast<size_t>(index) * m_scratchBytes; }
+	uint32_t get_scratch_bytes() const { return m_scratchBytes; }
+
+private:
+	AlignedArena m_arena;
+
+	uint32_t m_blockSize;
+	uint32_t m_scratchBytes;
+
+	float* m_inputs;	// numStreams blocks
+	float* m_output;
+	int16_t* m_inputs16;	// numStreams blocks
+	int16_t* m_output16;
+	uint8_t* m_scratch;	// numScratch blocks of m_scratchBytes
+};
+
+} // namespace Mixer
@@ -0,0 +1,186 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "ParallelRender.h"
+#include "MixKernels.h"
+#include "MixerContext.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Mixer {
+
+namespace {
+
+// Chunks handed out per worker, more than one so a slow worker does not hold up the end.
+constexpr uint32_t kChunksPerThread = 4;
+
+// Shared state between the render workers.
+struct RenderShared
+{
+	const RenderJob* m_job;
+	WavAudio::WavAudioFileOutput* m_output;
+	uint64_t m_firstSample;	// output samples rendered, [m_firstSample, m_endSample)
+	uint64_t m_endSample;
+	uint32_t m_numBlocks;	// blocks covering them, the last may be partial
+	uint32_t m_blocksPerChunk;
+	uint32_t m_numChunks;
+	std::atomic<uint32_t> m_nextChunk;
+
+	// first exception thrown by a worker, rethrown once all have joined.
+	std::mutex m_errorMutex;
+	std::exception_ptr m_error;
+};
+
+void render_worker(RenderShared& shared)
+{
+	const RenderJob& job = *shared.m_job;
+
+	try
+	{
+		// private input handles and buffers, the only shared object is the output.
+		std::unique_ptr<WavAudio::WavAudioFileInput[]> inputs(new WavAudio::WavAudioFileInput[job.m_numStreams]);
+		uint32_t maxBytesPerSample = shared.m_output->get_format().m_bitsPerSample / 8;
+		for (uint32_t i = 0; i < job.m_numStreams; ++i)
+		{
+			inputs[i].open(job.m_inputPaths[i], job.m_inputMode);
+			inputs[i].enable_resampling(shared.m_output->get_format().m_samplesPerSec, job.m_blockSize);
+			maxBytesPerSample = std::max<uint32_t>(maxBytesPerSample, inputs[i].get_format().m_bitsPerSample / 8);
+		}
+
+		const uint32_t scratchBytes = job.m_blockSize * maxBytesPerSample;
+		MixerContext context;
+		context.init(job.m_blockSize, job.m_numStreams, job.m_numStreams + 1, scratchBytes);
+		std::vector<const float*> streams(job.m_numStreams);
+		for (uint32_t i = 0; i < job.m_numStreams; ++i)
+		{
+			inputs[i].set_scratch_memory(context.get_scratch(i), scratchBytes);
+			streams[i] = context.get_inputs(i);
+		}
+		uint8_t* encodeScratch = context.get_scratch(job.m_numStreams);
+		const uint32_t numChannels = shared.m_output->get_channels();
+
+		for (;;)
+		{
+			const uint32_t chunk = shared.m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+			if (chunk >= shared.m_numChunks)
+			{
+				break;
+			}
+
+			TIMER_SCOPED("render chunk");
+			const uint32_t firstBlock = chunk * shared.m_blocksPerChunk;
+			const uint32_t lastBlock = std::min(firstBlock + shared.m_blocksPerChunk, shared.m_numBlocks);
+			const uint64_t chunkSample = shared.m_firstSample + static_cast<uint64_t>(firstBlock) * job.m_blockSize;
+			for (uint32_t i = 0; i < job.m_numStreams; ++i)
+			{
+				inputs[i].seek(chunkSample / numChannels);
+			}
+
+			for (uint32_t block = firstBlock; block < lastBlock; ++block)
+			{
+				// the whole block is mixed, only the part inside the range is read and written.
+				const uint64_t sample = shared.m_firstSample + static_cast<uint64_t>(block) * job.m_blockSize;
+				const uint32_t numSamples = static_cast<uint32_t>(std::min<uint64_t>(job.m_blockSize, shared.m_endSample - sample));
+				for (uint32_t i = 0; i < job.m_numStreams; ++i)
+				{
+					inputs[i].read(context.get_inputs(i), numSamples);
+				}
+				{
+					TIMER_SCOPED_FINE("mix block");
+					g_mixKernels.m_mixStreams(streams.data(), job.m_gains, job.m_numStreams, context.get_output(), job.m_blockSize);
+				}
+				shared.m_output->write_at(sample, context.get_output(), numSamples, encodeScratch);
+			}
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(shared.m_errorMutex);
+		if (!shared.m_error)
+		{
+			shared.m_error = std::current_exception();
+		}
+		// stop handing out work to the other workers.
+		shared.m_nextChunk.store(shared.m_numChunks, std::memory_order_relaxed);
+	}
+}
+
+// Renders output samples [firstSample, endSample) of a job on numThreads workers.
+uint32_t render_samples(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint64_t firstSample, uint64_t endSample, uint32_t numThreads)
+{
+	ASSERT(job.m_blockSize > 0 && job.m_numStreams > 0);
+	ASSERT(job.m_blockSize % output.get_channels() == 0 && firstSample % output.get_channels() == 0);
+	if (endSample <= firstSample)
+	{
+		return 0;
+	}
+	const uint32_t numBlocks = static_cast<uint32_t>((endSample - firstSample + job.m_blockSize - 1) / job.m_blockSize);
+
+	if (numThreads == 0)
+	{
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	numThreads = std::max(1u, std::min(numThreads, numBlocks));
+
+	RenderShared shared;
+	shared.m_job = &job;
+	shared.m_output = &output;
+	shared.m_firstSample = firstSample;
+	shared.m_endSample = endSample;
+	shared.m_numBlocks = numBlocks;
+	shared.m_numChunks = std::max(1u, std::min(numThreads * kChunksPerThread, numBlocks));
+	shared.m_blocksPerChunk = (numBlocks + shared.m_numChunks - 1) / shared.m_numChunks;
+	shared.m_numChunks = (numBlocks + shared.m_blocksPerChunk - 1) / shared.m_blocksPerChunk;
+	shared.m_nextChunk.store(0, std::memory_order_relaxed);
+
+	// the calling thread is the last worker, it keeps its own name in the profiler.
+	std::vector<std::thread> workers;
+	workers.reserve(numThreads - 1);
+	for (uint32_t i = 1; i < numThreads; ++i)
+	{
+		workers.emplace_back([&shared]()
+		{
+			TIMER_THREAD_NAME("render worker");
+			render_worker(shared);
+		});
+	}
+	render_worker(shared);
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	if (shared.m_error)
+	{
+		std::rethrow_exception(shared.m_error);
+	}
+	return numThreads;
+}
+
+} // namespace
+
+uint32_t render_parallel(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint32_t numThreads)
+{
+	return render_samples(job, output, 0, static_cast<uint64_t>(job.m_numBlocks) * job.m_blockSize, numThreads);
+}
+
+uint32_t render_region(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint64_t startFrame, uint64_t endFrame, uint32_t numThreads)
+{
+	const uint64_t numChannels = output.get_channels();
+	const uint64_t outputFrames = output.get_samples() / numChannels;
+	endFrame = std::min(endFrame, outputFrames);
+	if (startFrame >= endFrame)
+	{
+		return 0;
+	}
+	return render_samples(job, output, startFrame * numChannels, endFrame * numChannels, numThreads);
+}
+
+} // namespace Mixer
@@ -0,0 +1,39 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "WaveFile.h"
+
+namespace Mixer {
+
+// Describes an offline mix: every input is mixed with its L/R gain pair into
+// numBlocks blocks of blockSize samples.
+struct RenderJob
+{
+	const char* const* m_inputPaths;
+	const float* m_gains;	// numStreams L/R pairs
+	uint32_t m_numStreams;
+	uint32_t m_blockSize;
+	uint32_t m_numBlocks;
+	WavAudio::eInputMode m_inputMode;
+};
+
+// Renders a job into an open output using numThreads workers (0 picks one per hardware thread).
+// The timeline is cut into chunks of whole blocks handed out on demand. Each worker opens
+// its own input handles, seeks them to the chunk start, mixes with g_mixKernels and writes
+// the chunk to its precomputed offset in the output, so the result matches the serial mix.
+// Inputs at another sample rate are resampled to the output's, seeking restarts the
+// resampler with the same history so chunk edges match the serial mix too.
+// The output must not have write behind enabled. Returns the number of workers used.
+uint32_t render_parallel(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint32_t numThreads);
+
+// Renders only frames [startFrame, endFrame) of a job, the same way render_parallel does, and
+// writes them over the same frames of output. Made for fixing part of a finished mix opened
+// with open_patch: the inputs are read from startFrame on and nothing outside the region is
+// touched, so the cost follows the length of the region. The region is clipped to the
+// output's length and m_numBlocks is not used. Returns the number of workers used.
+uint32_t render_region(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint64_t startFrame, uint64_t endFrame, uint32_t numThreads);
+
+} // namespace Mixer
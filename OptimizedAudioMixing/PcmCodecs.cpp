@@ -0,0 +1,687 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "PcmCodecs.h"
+#include <algorithm>
+#include <immintrin.h>
+#include <limits>
+#include <vector>
+
+namespace WavAudio {
+
+constexpr uint32_t kMax16 = 1 << (16 - 1); // i.e. 2^(bitdepth-1)
+constexpr float kfDecode16 = 1.0f / kMax16;
+constexpr float kfEncode16 = kMax16;
+constexpr float kfEncodeMin16 = -32768.0f;
+constexpr float kfEncodeMax16 = 32767.0f;
+
+constexpr uint32_t kMax24 = 1 << (24 - 1);
+constexpr float kfDecode24 = 1.0f / kMax24;
+constexpr float kfEncode24 = kMax24;
+constexpr float kfEncodeMin24 = -8388608.0f;
+constexpr float kfEncodeMax24 = 8388607.0f;
+
+constexpr float kfDecode32 = 1.0f / 2147483648.0f;
+constexpr float kfEncode32 = 2147483648.0f;
+constexpr float kfEncodeMin32 = -2147483648.0f;
+constexpr float kfEncodeMax32 = 2147483520.0f; // largest float below 2^31, which would overflow
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar reference.
+// The vector codecs must match these bit for bit.
+//////////////////////////////////////////////////////////////////////////
+void decode_16bit_pcm_to_float_scalar(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		outBuffer[i] = (float)pIn[i] * kfDecode16;
+	}
+}
+
+void encode_float_to_16bit_scalar(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		// Clamp in the same order as max_ps/min_ps so NaN ends up at the minimum, then truncate.
+		float sample = inBuffer[i] * kfEncode16;
+		sample = sample > kfEncodeMin16 ? sample : kfEncodeMin16;
+		sample = sample < kfEncodeMax16 ? sample : kfEncodeMax16;
+		pOut[i] = static_cast<int16_t>(static_cast<int32_t>(sample));
+	}
+}
+
+void decode_24bit_pcm_to_float_scalar(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const uint8_t* pIn = inBuffer;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		// little endian, shift into the top of an int32 then back down to sign extend.
+		const uint32_t packed = (uint32_t(pIn[2]) << 24) | (uint32_t(pIn[1]) << 16) | (uint32_t(pIn[0]) << 8);
+		const int32_t sample = static_cast<int32_t>(packed) >> 8;
+		outBuffer[i] = (float)sample * kfDecode24;
+		pIn += 3;
+	}
+}
+
+void encode_float_to_24bit_scalar(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	uint8_t* pOut = outBuffer;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		// same clamp and truncation as the 16 bit encoder.
+		float sample = inBuffer[i] * kfEncode24;
+		sample = sample > kfEncodeMin24 ? sample : kfEncodeMin24;
+		sample = sample < kfEncodeMax24 ? sample : kfEncodeMax24;
+		const uint32_t value = static_cast<uint32_t>(static_cast<int32_t>(sample));
+		pOut[0] = static_cast<uint8_t>(value);
+		pOut[1] = static_cast<uint8_t>(value >> 8);
+		pOut[2] = static_cast<uint8_t>(value >> 16);
+		pOut += 3;
+	}
+}
+
+void decode_32bit_pcm_to_float_scalar(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int32_t* pIn = reinterpret_cast<const int32_t*>(inBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		outBuffer[i] = (float)pIn[i] * kfDecode32;
+	}
+}
+
+void encode_float_to_32bit_scalar(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int32_t* pOut = reinterpret_cast<int32_t*>(outBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		float sample = inBuffer[i] * kfEncode32;
+		sample = sample > kfEncodeMin32 ? sample : kfEncodeMin32;
+		sample = sample < kfEncodeMax32 ? sample : kfEncodeMax32;
+		pOut[i] = static_cast<int32_t>(sample);
+	}
+}
+
+// Number of samples the 24bit vector loops can take when each step of stepSamples
+// reads or writes loadBytes, without going past the end of the buffer.
+inline uint32_t decode_24bit_vector_end(uint32_t numSamples, uint32_t stepSamples, uint32_t loadBytes)
+{
+	const uint32_t numBytes = numSamples * 3;
+	if (numBytes < loadBytes)
+	{
+		return 0;
+	}
+	const uint32_t safeSamples = (numBytes - loadBytes) / 3 + 1;
+	return safeSamples / stepSamples * stepSamples;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 128bit
+//////////////////////////////////////////////////////////////////////////
+void decode_16bit_pcm_to_float_sse(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
+	const __m128 scale = _mm_set1_ps(kfDecode16);
+
+	const uint32_t vectorEnd = numSamples & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pIn[i]));
+		// sign extend by unpacking into the top half and shifting back down.
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+		_mm_storeu_ps(&outBuffer[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(&outBuffer[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	decode_16bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+void encode_float_to_16bit_sse(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
+	const __m128 scale = _mm_set1_ps(kfEncode16);
+	const __m128 minimum = _mm_set1_ps(kfEncodeMin16);
+	const __m128 maximum = _mm_set1_ps(kfEncodeMax16);
+
+	const uint32_t vectorEnd = numSamples & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&inBuffer[i]), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(&inBuffer[i + 4]), scale);
+		a = _mm_min_ps(_mm_max_ps(a, minimum), maximum);
+		b = _mm_min_ps(_mm_max_ps(b, minimum), maximum);
+
+		// truncate and saturate down to int16.
+		const __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pOut[i]), packed);
+	}
+
+	encode_float_to_16bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+void decode_32bit_pcm_to_float_sse(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int32_t* pIn = reinterpret_cast<const int32_t*>(inBuffer);
+	const __m128 scale = _mm_set1_ps(kfDecode32);
+
+	const uint32_t vectorEnd = numSamples & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pIn[i]));
+		_mm_storeu_ps(&outBuffer[i], _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+	}
+
+	decode_32bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+void encode_float_to_32bit_sse(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int32_t* pOut = reinterpret_cast<int32_t*>(outBuffer);
+	const __m128 scale = _mm_set1_ps(kfEncode32);
+	const __m128 minimum = _mm_set1_ps(kfEncodeMin32);
+	const __m128 maximum = _mm_set1_ps(kfEncodeMax32);
+
+	const uint32_t vectorEnd = numSamples & ~3u;
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&inBuffer[i]), scale);
+		a = _mm_min_ps(_mm_max_ps(a, minimum), maximum);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pOut[i]), _mm_cvttps_epi32(a));
+	}
+
+	encode_float_to_32bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+TARGET_SSSE3 void decode_24bit_pcm_to_float_ssse3(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	// Moves 4 packed 3 byte samples into the top 3 bytes of each 32bit lane, the low byte is zeroed.
+	const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m128 scale = _mm_set1_ps(kfDecode24);
+
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 4, 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&inBuffer[i * 3]));
+		const __m128i samples = _mm_srai_epi32(_mm_shuffle_epi8(bytes, unpack), 8);
+		_mm_storeu_ps(&outBuffer[i], _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+	}
+
+	decode_24bit_pcm_to_float_scalar(&inBuffer[vectorEnd * 3], &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_SSSE3 void encode_float_to_24bit_ssse3(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	// Keeps the low 3 bytes of each 32bit lane, packed into the first 12 bytes.
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m128 scale = _mm_set1_ps(kfEncode24);
+	const __m128 minimum = _mm_set1_ps(kfEncodeMin24);
+	const __m128 maximum = _mm_set1_ps(kfEncodeMax24);
+
+	// each pass stores 16 bytes, the 4 past its samples are overwritten by the next pass.
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 4, 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 4)
+	{
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&inBuffer[i]), scale);
+		a = _mm_min_ps(_mm_max_ps(a, minimum), maximum);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&outBuffer[i * 3]), _mm_shuffle_epi8(_mm_cvttps_epi32(a), pack));
+	}
+
+	encode_float_to_24bit_scalar(&inBuffer[vectorEnd], &outBuffer[vectorEnd * 3], numSamples - vectorEnd);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 256bit
+//////////////////////////////////////////////////////////////////////////
+TARGET_AVX2 void decode_16bit_pcm_to_float_avx2(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
+	const __m256 scale = _mm256_set1_ps(kfDecode16);
+
+	const uint32_t vectorEnd = numSamples & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pIn[i]));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pIn[i + 8]));
+		_mm256_storeu_ps(&outBuffer[i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), scale));
+		_mm256_storeu_ps(&outBuffer[i + 8], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), scale));
+	}
+
+	decode_16bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX2 void encode_float_to_16bit_avx2(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
+	const __m256 scale = _mm256_set1_ps(kfEncode16);
+	const __m256 minimum = _mm256_set1_ps(kfEncodeMin16);
+	const __m256 maximum = _mm256_set1_ps(kfEncodeMax16);
+
+	const uint32_t vectorEnd = numSamples & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&inBuffer[i]), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(&inBuffer[i + 8]), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, minimum), maximum);
+		b = _mm256_min_ps(_mm256_max_ps(b, minimum), maximum);
+
+		// packs works per 128bit lane, so restore sample order afterwards: a0-3 b0-3 a4-7 b4-7 -> a b
+		const __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pOut[i]), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	encode_float_to_16bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+TARGET_AVX2 void decode_24bit_pcm_to_float_avx2(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const __m256i unpack = _mm256_setr_epi8(
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m256 scale = _mm256_set1_ps(kfDecode24);
+
+	// 8 samples per pass, each 128bit lane holds 4 of them.
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 8, 12 + 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		const uint8_t* pIn = &inBuffer[i * 3];
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 12));
+		const __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		const __m256i samples = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, unpack), 8);
+		_mm256_storeu_ps(&outBuffer[i], _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+	}
+
+	decode_24bit_pcm_to_float_scalar(&inBuffer[vectorEnd * 3], &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX2 void encode_float_to_24bit_avx2(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	const __m256i pack = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256 scale = _mm256_set1_ps(kfEncode24);
+	const __m256 minimum = _mm256_set1_ps(kfEncodeMin24);
+	const __m256 maximum = _mm256_set1_ps(kfEncodeMax24);
+
+	// 8 samples per pass, each 128bit lane packs 4 and the upper lane's store covers the lower's spare bytes.
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 8, 12 + 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&inBuffer[i]), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, minimum), maximum);
+		const __m256i packed = _mm256_shuffle_epi8(_mm256_cvttps_epi32(a), pack);
+		uint8_t* pOut = &outBuffer[i * 3];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm256_castsi256_si128(packed));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 12), _mm256_extracti128_si256(packed, 1));
+	}
+
+	encode_float_to_24bit_scalar(&inBuffer[vectorEnd], &outBuffer[vectorEnd * 3], numSamples - vectorEnd);
+}
+
+TARGET_AVX2 void decode_32bit_pcm_to_float_avx2(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int32_t* pIn = reinterpret_cast<const int32_t*>(inBuffer);
+	const __m256 scale = _mm256_set1_ps(kfDecode32);
+
+	const uint32_t vectorEnd = numSamples & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pIn[i]));
+		_mm256_storeu_ps(&outBuffer[i], _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+	}
+
+	decode_32bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX2 void encode_float_to_32bit_avx2(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int32_t* pOut = reinterpret_cast<int32_t*>(outBuffer);
+	const __m256 scale = _mm256_set1_ps(kfEncode32);
+	const __m256 minimum = _mm256_set1_ps(kfEncodeMin32);
+	const __m256 maximum = _mm256_set1_ps(kfEncodeMax32);
+
+	const uint32_t vectorEnd = numSamples & ~7u;
+	for (uint32_t i = 0; i < vectorEnd; i += 8)
+	{
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&inBuffer[i]), scale);
+		a = _mm256_min_ps(_mm256_max_ps(a, minimum), maximum);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pOut[i]), _mm256_cvttps_epi32(a));
+	}
+
+	encode_float_to_32bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 512bit
+//////////////////////////////////////////////////////////////////////////
+TARGET_AVX512 void decode_16bit_pcm_to_float_avx512(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
+	const __m512 scale = _mm512_set1_ps(kfDecode16);
+
+	const uint32_t vectorEnd = numSamples & ~31u;
+	for (uint32_t i = 0; i < vectorEnd; i += 32)
+	{
+		const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pIn[i]));
+		const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pIn[i + 16]));
+		_mm512_storeu_ps(&outBuffer[i], _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(lo)), scale));
+		_mm512_storeu_ps(&outBuffer[i + 16], _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(hi)), scale));
+	}
+
+	decode_16bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX512 void encode_float_to_16bit_avx512(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
+	const __m512 scale = _mm512_set1_ps(kfEncode16);
+	const __m512 minimum = _mm512_set1_ps(kfEncodeMin16);
+	const __m512 maximum = _mm512_set1_ps(kfEncodeMax16);
+	// qword order after a per lane pack: a0-3 b0-3 a4-7 b4-7 a8-11 b8-11 a12-15 b12-15
+	const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+
+	const uint32_t vectorEnd = numSamples & ~31u;
+	for (uint32_t i = 0; i < vectorEnd; i += 32)
+	{
+		__m512 a = _mm512_mul_ps(_mm512_loadu_ps(&inBuffer[i]), scale);
+		__m512 b = _mm512_mul_ps(_mm512_loadu_ps(&inBuffer[i + 16]), scale);
+		a = _mm512_min_ps(_mm512_max_ps(a, minimum), maximum);
+		b = _mm512_min_ps(_mm512_max_ps(b, minimum), maximum);
+
+		const __m512i packed = _mm512_packs_epi32(_mm512_cvttps_epi32(a), _mm512_cvttps_epi32(b));
+		_mm512_storeu_si512(&pOut[i], _mm512_permutexvar_epi64(order, packed));
+	}
+
+	encode_float_to_16bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+TARGET_AVX512 void decode_24bit_pcm_to_float_avx512(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const __m512i unpack = _mm512_broadcast_i32x4(_mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+	const __m512 scale = _mm512_set1_ps(kfDecode24);
+
+	// 16 samples per pass, each 128bit lane holds 4 of them.
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 16, 36 + 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		const uint8_t* pIn = &inBuffer[i * 3];
+		__m512i bytes = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn)));
+		bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 12)), 1);
+		bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 24)), 2);
+		bytes = _mm512_inserti32x4(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 36)), 3);
+		const __m512i samples = _mm512_srai_epi32(_mm512_shuffle_epi8(bytes, unpack), 8);
+		_mm512_storeu_ps(&outBuffer[i], _mm512_mul_ps(_mm512_cvtepi32_ps(samples), scale));
+	}
+
+	decode_24bit_pcm_to_float_scalar(&inBuffer[vectorEnd * 3], &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX512 void encode_float_to_24bit_avx512(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	const __m512i pack = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	const __m512 scale = _mm512_set1_ps(kfEncode24);
+	const __m512 minimum = _mm512_set1_ps(kfEncodeMin24);
+	const __m512 maximum = _mm512_set1_ps(kfEncodeMax24);
+
+	// 16 samples per pass, stored a 128bit lane at a time in order so each covers the previous spare bytes.
+	const uint32_t vectorEnd = decode_24bit_vector_end(numSamples, 16, 36 + 16);
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 a = _mm512_mul_ps(_mm512_loadu_ps(&inBuffer[i]), scale);
+		a = _mm512_min_ps(_mm512_max_ps(a, minimum), maximum);
+		const __m512i packed = _mm512_shuffle_epi8(_mm512_cvttps_epi32(a), pack);
+		uint8_t* pOut = &outBuffer[i * 3];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm512_castsi512_si128(packed));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 12), _mm512_extracti32x4_epi32(packed, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 24), _mm512_extracti32x4_epi32(packed, 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 36), _mm512_extracti32x4_epi32(packed, 3));
+	}
+
+	encode_float_to_24bit_scalar(&inBuffer[vectorEnd], &outBuffer[vectorEnd * 3], numSamples - vectorEnd);
+}
+
+TARGET_AVX512 void decode_32bit_pcm_to_float_avx512(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	const int32_t* pIn = reinterpret_cast<const int32_t*>(inBuffer);
+	const __m512 scale = _mm512_set1_ps(kfDecode32);
+
+	const uint32_t vectorEnd = numSamples & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		const __m512i samples = _mm512_loadu_si512(&pIn[i]);
+		_mm512_storeu_ps(&outBuffer[i], _mm512_mul_ps(_mm512_cvtepi32_ps(samples), scale));
+	}
+
+	decode_32bit_pcm_to_float_scalar(reinterpret_cast<const uint8_t*>(&pIn[vectorEnd]), &outBuffer[vectorEnd], numSamples - vectorEnd);
+}
+
+TARGET_AVX512 void encode_float_to_32bit_avx512(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int32_t* pOut = reinterpret_cast<int32_t*>(outBuffer);
+	const __m512 scale = _mm512_set1_ps(kfEncode32);
+	const __m512 minimum = _mm512_set1_ps(kfEncodeMin32);
+	const __m512 maximum = _mm512_set1_ps(kfEncodeMax32);
+
+	const uint32_t vectorEnd = numSamples & ~15u;
+	for (uint32_t i = 0; i < vectorEnd; i += 16)
+	{
+		__m512 a = _mm512_mul_ps(_mm512_loadu_ps(&inBuffer[i]), scale);
+		a = _mm512_min_ps(_mm512_max_ps(a, minimum), maximum);
+		_mm512_storeu_si512(&pOut[i], _mm512_cvttps_epi32(a));
+	}
+
+	encode_float_to_32bit_scalar(&inBuffer[vectorEnd], reinterpret_cast<uint8_t*>(&pOut[vectorEnd]), numSamples - vectorEnd);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Registry
+//////////////////////////////////////////////////////////////////////////
+PcmCodecTable g_pcmCodecs = { eKernelIsa::kScalar, decode_16bit_pcm_to_float_scalar, encode_float_to_16bit_scalar,
+	decode_24bit_pcm_to_float_scalar, encode_float_to_24bit_scalar, decode_32bit_pcm_to_float_scalar, encode_float_to_32bit_scalar };
+
+PcmCodecTable get_pcm_codecs(eKernelIsa isa)
+{
+	switch (isa)
+	{
+	case eKernelIsa::kSSE:
+	{
+		// the 24bit shuffles need ssse3 which plain sse2 hosts may not have.
+		const bool ssse3 = get_cpu_features().m_ssse3;
+		return { isa, decode_16bit_pcm_to_float_sse, encode_float_to_16bit_sse,
+			ssse3 ? decode_24bit_pcm_to_float_ssse3 : decode_24bit_pcm_to_float_scalar,
+			ssse3 ? encode_float_to_24bit_ssse3 : encode_float_to_24bit_scalar,
+			decode_32bit_pcm_to_float_sse, encode_float_to_32bit_sse };
+	}
+	case eKernelIsa::kAVX2:
+		return { isa, decode_16bit_pcm_to_float_avx2, encode_float_to_16bit_avx2,
+			decode_24bit_pcm_to_float_avx2, encode_float_to_24bit_avx2, decode_32bit_pcm_to_float_avx2, encode_float_to_32bit_avx2 };
+	case eKernelIsa::kAVX512:
+		return { isa, decode_16bit_pcm_to_float_avx512, encode_float_to_16bit_avx512,
+			decode_24bit_pcm_to_float_avx512, encode_float_to_24bit_avx512, decode_32bit_pcm_to_float_avx512, encode_float_to_32bit_avx512 };
+	default:
+		return { eKernelIsa::kScalar, decode_16bit_pcm_to_float_scalar, encode_float_to_16bit_scalar,
+			decode_24bit_pcm_to_float_scalar, encode_float_to_24bit_scalar, decode_32bit_pcm_to_float_scalar, encode_float_to_32bit_scalar };
+	}
+}
+
+void bind_pcm_codecs()
+{
+	g_pcmCodecs = get_pcm_codecs(get_best_kernel_isa());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Verification
+//////////////////////////////////////////////////////////////////////////
+namespace {
+
+// Compares two buffers byte for byte, odd lengths exercise the scalar tails.
+bool check_codec_output(std::ostream& streamOut, const char* codec, eKernelIsa isa, const void* expected, const void* actual, size_t bytes)
+{
+	const uint8_t* pExpected = static_cast<const uint8_t*>(expected);
+	const uint8_t* pActual = static_cast<const uint8_t*>(actual);
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		if (pExpected[i] != pActual[i])
+		{
+			streamOut << "Codec mismatch: " << codec << " " << get_kernel_isa_name(isa) << " at byte " << i << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+bool verify_pcm_codecs(std::ostream& streamOut)
+{
+	// Every int16 value, and a spread of 24 and 32bit values covering both signs and the extremes.
+	const uint32_t kNumSamples = 65536 + 13;
+
+	std::vector<uint8_t> pcm16(kNumSamples * 2);
+	std::vector<uint8_t> pcm24(kNumSamples * 3);
+	std::vector<uint8_t> pcm32(kNumSamples * 4);
+	for (uint32_t i = 0; i < kNumSamples; ++i)
+	{
+		const uint16_t value16 = static_cast<uint16_t>(i);
+		pcm16[i * 2 + 0] = static_cast<uint8_t>(value16);
+		pcm16[i * 2 + 1] = static_cast<uint8_t>(value16 >> 8);
+
+		const uint32_t value24 = (i * 2654435761u) >> 8;
+		pcm24[i * 3 + 0] = static_cast<uint8_t>(value24);
+		pcm24[i * 3 + 1] = static_cast<uint8_t>(value24 >> 8);
+		pcm24[i * 3 + 2] = static_cast<uint8_t>(value24 >> 16);
+
+		const uint32_t value32 = i < 2 ? 0x7FFFFFFFu + i : i * 2654435761u;
+		memcpy(&pcm32[i * 4], &value32, sizeof(value32));
+	}
+
+	// Floats well outside [-1, 1] to exercise the clamp, including infinities and NaN.
+	std::vector<float> floats(kNumSamples);
+	for (uint32_t i = 0; i < kNumSamples; ++i)
+	{
+		floats[i] = (static_cast<float>(i) / kNumSamples - 0.5f) * 4.0f;
+	}
+	floats[1] = 1.0f;
+	floats[2] = -1.0f;
+	floats[3] = std::numeric_limits<float>::infinity();
+	floats[4] = -std::numeric_limits<float>::infinity();
+	floats[5] = std::numeric_limits<float>::quiet_NaN();
+
+	const PcmCodecTable reference = get_pcm_codecs(eKernelIsa::kScalar);
+	std::vector<float> expectedFloats(kNumSamples), actualFloats(kNumSamples);
+	std::vector<uint8_t> expectedPcm(kNumSamples * 4), actualPcm(kNumSamples * 4);
+
+	bool ok = true;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(eKernelIsa::kCount); ++i)
+	{
+		const eKernelIsa isa = static_cast<eKernelIsa>(i);
+		if (!is_kernel_isa_supported(isa))
+		{
+			continue;
+		}
+
+		const PcmCodecTable codecs = get_pcm_codecs(isa);
+
+		reference.m_decode16(pcm16.data(), expectedFloats.data(), kNumSamples);
+		codecs.m_decode16(pcm16.data(), actualFloats.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "decode16", isa, expectedFloats.data(), actualFloats.data(), kNumSamples * sizeof(float));
+
+		reference.m_encode16(floats.data(), expectedPcm.data(), kNumSamples);
+		codecs.m_encode16(floats.data(), actualPcm.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "encode16", isa, expectedPcm.data(), actualPcm.data(), kNumSamples * 2);
+
+		reference.m_decode24(pcm24.data(), expectedFloats.data(), kNumSamples);
+		codecs.m_decode24(pcm24.data(), actualFloats.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "decode24", isa, expectedFloats.data(), actualFloats.data(), kNumSamples * sizeof(float));
+
+		reference.m_encode24(floats.data(), expectedPcm.data(), kNumSamples);
+		codecs.m_encode24(floats.data(), actualPcm.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "encode24", isa, expectedPcm.data(), actualPcm.data(), kNumSamples * 3);
+
+		reference.m_decode32(pcm32.data(), expectedFloats.data(), kNumSamples);
+		codecs.m_decode32(pcm32.data(), actualFloats.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "decode32", isa, expectedFloats.data(), actualFloats.data(), kNumSamples * sizeof(float));
+
+		reference.m_encode32(floats.data(), expectedPcm.data(), kNumSamples);
+		codecs.m_encode32(floats.data(), actualPcm.data(), kNumSamples);
+		ok &= check_codec_output(streamOut, "encode32", isa, expectedPcm.data(), actualPcm.data(), kNumSamples * 4);
+	}
+	return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Channel interleaving
+//////////////////////////////////////////////////////////////////////////
+namespace {
+
+template<uint32_t NumChannels>
+void deinterleave_channels(const float* in, float* const* planes, uint32_t numFrames)
+{
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t c = 0; c < NumChannels; ++c)
+		{
+			planes[c][f] = in[f * NumChannels + c];
+		}
+	}
+}
+
+template<uint32_t NumChannels>
+void interleave_channels(const float* const* planes, float* out, uint32_t numFrames)
+{
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t c = 0; c < NumChannels; ++c)
+		{
+			out[f * NumChannels + c] = planes[c][f];
+		}
+	}
+}
+
+} // namespace
+
+void deinterleave(const float* in, float* const* planes, uint32_t numChannels, uint32_t numFrames)
+{
+	// fixed channel counts let the compiler unroll the inner loop.
+	switch (numChannels)
+	{
+	case 1: std::copy(in, in + numFrames, planes[0]); break;
+	case 2: deinterleave_channels<2>(in, planes, numFrames); break;
+	case 6: deinterleave_channels<6>(in, planes, numFrames); break;
+	case 8: deinterleave_channels<8>(in, planes, numFrames); break;
+	default:
+		for (uint32_t f = 0; f < numFrames; ++f)
+		{
+			for (uint32_t c = 0; c < numChannels; ++c)
+			{
+				planes[c][f] = in[f * numChannels + c];
+			}
+		}
+		break;
+	}
+}
+
+void interleave(const float* const* planes, float* out, uint32_t numChannels, uint32_t numFrames)
+{
+	switch (numChannels)
+	{
+	case 1: std::copy(planes[0], planes[0] + numFrames, out); break;
+	case 2: interleave_channels<2>(planes, out, numFrames); break;
+	case 6: interleave_channels<6>(planes, out, numFrames); break;
+	case 8: interleave_channels<8>(planes, out, numFrames); break;
+	default:
+		for (uint32_t f = 0; f < numFrames; ++f)
+		{
+			for (uint32_t c = 0; c < numChannels; ++c)
+			{
+				out[f * numChannels + c] = planes[c][f];
+			}
+		}
+		break;
+	}
+}
+
+} // namespace WavAudio
@@ -0,0 +1,78 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <ostream>
+
+namespace WavAudio {
+
+// Converts between PCM sample data and normalized floats in [-1, 1).
+typedef void (*DecodeToFloatFunc)(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples);
+typedef void (*EncodeFromFloatFunc)(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples);
+
+// One set of sample codecs, all built for the same instruction set.
+struct PcmCodecTable
+{
+	eKernelIsa m_isa;
+	DecodeToFloatFunc m_decode16;		// int16 -> float
+	EncodeFromFloatFunc m_encode16;		// float -> int16, clamped to the int16 range
+	DecodeToFloatFunc m_decode24;		// packed little endian int24 -> float
+	EncodeFromFloatFunc m_encode24;		// float -> packed int24, clamped to the int24 range
+	DecodeToFloatFunc m_decode32;		// int32 -> float
+	EncodeFromFloatFunc m_encode32;		// float -> int32, clamped to the int32 range
+};
+
+// Codec table for a specific width, whether or not the host can run it.
+PcmCodecTable get_pcm_codecs(eKernelIsa isa);
+
+// Binds the widest codecs the host supports into g_pcmCodecs.
+// Until this is called the scalar codecs are bound.
+void bind_pcm_codecs();
+
+// Checks every codec width the host supports bit for bit against the scalar reference.
+// Returns false and reports the first mismatch if any differ.
+bool verify_pcm_codecs(std::ostream& streamOut);
+
+// The codecs bound for this host.
+extern PcmCodecTable g_pcmCodecs;
+
+// Splits an interleaved block into one plane per channel, and back again.
+void deinterleave(const float* in, float* const* planes, uint32_t numChannels, uint32_t numFrames);
+void interleave(const float* const* planes, float* out, uint32_t numChannels, uint32_t numFrames);
+
+// 32 bit float samples are already what the mixer works on, a plain copy either way.
+inline void decode_float_pcm_to_float(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+{
+	memcpy(outBuffer, inBuffer, numSamples * sizeof(float));
+}
+
+inline void encode_float_to_float_pcm(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	memcpy(outBuffer, inBuffer, numSamples * sizeof(float));
+}
+
+//NEW -- 16 bit passthrough
+inline void decode_16bit_pcm_to_16bit(const uint8_t* inBuffer, int16_t* outBuffer, uint32_t numSamples)
+{
+	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		outBuffer[i] = pIn[i];
+	}
+}
+
+//NEW -- 16 bit passback
+inline void encode_16bit_to_16bit(const int16_t* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+{
+	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		pOut[i] = inBuffer[i];
+	}
+}
+
+} // namespace WavAudio
@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Prefetcher.h"
+#include "ActivityMap.h"
+#include "Profiler.h"
+
+namespace WavAudio {
+
+WavAudioPrefetcher::WavAudioPrefetcher()
+	: m_input{ nullptr }
+	, m_activity{ nullptr }
+	, m_blockSize{ 0 }
+	, m_depth{ 0 }
+	, m_blockStride{ 0 }
+	, m_blocks{ nullptr }
+	, m_silence{ nullptr }
+	, m_readIndex{ 0 }
+	, m_writeIndex{ 0 }
+	, m_inputExhausted{ false }
+	, m_stopRequested{ false }
+	, m_holdingSilence{ false }
+	, m_stallCount{ 0 }
+{}
+
+WavAudioPrefetcher::~WavAudioPrefetcher()
+{
+	stop();
+}
+
+void WavAudioPrefetcher::start(WavAudioFileInput& input, uint32_t blockSize, uint32_t depth, const ActivityMap* activity)
+{
+	ASSERT(depth > 0 && blockSize > 0);
+	stop();
+
+	m_input = &input;
+	m_activity = activity;
+	m_blockSize = blockSize;
+	m_depth = depth;
+
+	const size_t blockBytes = AlignedArena::aligned_size(static_cast<size_t>(blockSize) * sizeof(float));
+	m_arena.init(blockBytes * (depth + 1));
+	// keep each block on an aligned boundary even if the block size is not.
+	m_blockStride = static_cast<uint32_t>(blockBytes / sizeof(float));
+	m_blocks = m_arena.allocate_array<float>(static_cast<size_t>(m_blockStride) * depth);
+	m_silence = m_arena.allocate_array<float>(blockSize);
+	std::fill(m_silence, m_silence + blockSize, 0.0f);
+
+	m_readIndex = 0;
+	m_writeIndex = 0;
+	m_inputExhausted = false;
+	m_stopRequested = false;
+	m_holdingSilence = false;
+	m_stallCount.store(0, std::memory_order_relaxed);
+
+	m_thread = std::thread(&WavAudioPrefetcher::reader_thread, this);
+}
+
+void WavAudioPrefetcher::stop()
+{
+	if (!m_thread.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopRequested = true;
+	}
+	m_slotFree.notify_one();
+	m_thread.join();
+	m_input = nullptr;
+}
+
+const float* WavAudioPrefetcher::acquire_block()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_readIndex == m_writeIndex && !m_inputExhausted)
+	{
+		m_stallCount.fetch_add(1, std::memory_order_relaxed);
+		m_blockReady.wait(lock, [this]() { return m_readIndex != m_writeIndex || m_inputExhausted; });
+	}
+
+	if (m_readIndex == m_writeIndex)
+	{
+		// reader has finished and everything has been consumed.
+		m_holdingSilence = true;
+		return m_silence;
+	}
+
+	m_holdingSilence = false;
+	return block_at(m_readIndex);
+}
+
+void WavAudioPrefetcher::release_block()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_holdingSilence)
+		{
+			return;
+		}
+		++m_readIndex;
+	}
+	m_slotFree.notify_one();
+}
+
+void WavAudioPrefetcher::reader_thread()
+{
+	TIMER_THREAD_NAME("prefetch");
+
+	for (;;)
+	{
+		// wait for a free slot in the ring.
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_slotFree.wait(lock, [this]() { return m_stopRequested || m_writeIndex - m_readIndex < m_depth; });
+			if (m_stopRequested)
+			{
+				return;
+			}
+		}
+
+		// The slot at m_writeIndex is ours until we publish it, read and decode outside the lock.
+		const uint32_t samples = static_cast<uint32_t>(std::min<uint64_t>(m_input->samples_remaining(), m_blockSize));
+		float* block = block_at(m_writeIndex);
+		if (m_activity != nullptr && samples > 0 && !m_activity->is_active(m_writeIndex))
+		{
+			m_input->skip(samples);
+		}
+		else
+		{
+			if (samples > 0)
+			{
+				TIMER_SCOPED("prefetch block");
+				m_input->read(block, samples);
+			}
+			std::fill(block + samples, block + m_blockSize, 0.0f);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (samples > 0)
+			{
+				++m_writeIndex;
+			}
+			m_inputExhausted = samples < m_blockSize;
+		}
+		m_blockReady.notify_one();
+
+		if (samples < m_blockSize)
+		{
+			return;
+		}
+	}
+}
+
+} // namespace WavAudio
@@ -0,0 +1,82 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "WaveFile.h"
+#include "AlignedArena.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace WavAudio {
+
+class ActivityMap;
+
+// Read ahead stage for one input file.
+// A background thread reads and decodes up to `depth` blocks ahead into a ring of
+// float buffers, the mixer consumes them in order and only waits when the ring is empty.
+//
+//		const float* block = prefetcher.acquire_block();
+//		... mix block ...
+//		prefetcher.release_block();
+class WavAudioPrefetcher
+{
+public:
+	WavAudioPrefetcher();
+	~WavAudioPrefetcher();
+
+	WavAudioPrefetcher(const WavAudioPrefetcher&) = delete;
+	WavAudioPrefetcher& operator = (const WavAudioPrefetcher&) = delete;
+
+	// Starts reading blocks of blockSize samples from input, which must stay open until stop().
+	// The input must not be read by anyone else while the prefetcher runs.
+	// Blocks activity marks silent are skipped, not decoded, and their slot holds stale data
+	// the mixer must not use. The map must be built with the same block size.
+	void start(WavAudioFileInput& input, uint32_t blockSize, uint32_t depth, const ActivityMap* activity = nullptr);
+
+	// Stops and joins the background thread, any unconsumed blocks are dropped.
+	void stop();
+
+	// Next decoded block, waits for the reader if it is not ready yet.
+	// Once the input runs out this returns silence.
+	// Valid until release_block(), only one block may be held at a time.
+	const float* acquire_block();
+
+	// Hands the block from acquire_block() back to the reader.
+	void release_block();
+
+	// Number of times acquire_block() had to wait for the reader.
+	uint32_t get_stall_count() const { return m_stallCount.load(std::memory_order_relaxed); }
+
+private:
+	void reader_thread();
+
+	float* block_at(uint32_t index) { return m_blocks + static_cast<size_t>(index % m_depth) * m_blockStride; }
+
+	WavAudioFileInput* m_input;
+	const ActivityMap* m_activity;	// optional, silent blocks are skipped
+	uint32_t m_blockSize;	// samples per block
+	uint32_t m_depth;		// blocks in the ring
+	uint32_t m_blockStride;	// floats between ring blocks, m_blockSize rounded up to the arena alignment
+
+	AlignedArena m_arena;		// backs the ring and the silence block, every block 64 byte aligned
+	float* m_blocks;			// ring storage, m_depth blocks
+	float* m_silence;			// handed out once the input is exhausted
+
+	std::mutex m_mutex;
+	std::condition_variable m_blockReady;	// reader -> mixer
+	std::condition_variable m_slotFree;		// mixer -> reader
+	uint32_t m_readIndex;		// next block the mixer consumes
+	uint32_t m_writeIndex;		// next block the reader fills
+	bool m_inputExhausted;
+	bool m_stopRequested;
+	bool m_holdingSilence;
+	std::atomic<uint32_t> m_stallCount;
+
+	std::thread m_thread;
+};
+
+} // namespace WavAudio
@@ -1,107 +1,375 @@
 #include "Profiler.h"
+#include "ProfilerStats.h"
+#include <vector>
+#include <tuple>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <string>
+#include <ctime>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t kCalibrationRounds = 101;
+constexpr uint32_t kCalibrationTimers = 64;	// empty timers per round
+
+const char* const kLogPath = "datalog.csv";			// per scope statistics, one row per scope per run
+const char* const kRawLogPath = "datalog_raw.csv";	// every record, CONDENSED_TIMINGS 0 only
+const char* const kTracePath = "trace.json";			// CHROME_TRACE_OUTPUT 1 only
+
+// A thread's log and the records it points at.
+struct OwnedThreadLog
+{
+	Profiler::ThreadLog m_log;
+	std::unique_ptr<Profiler::TimerRecord[]> m_records;
+};
+
+// Every thread's log, kept until exit so output_data can read threads that have finished.
+std::mutex g_threadLogsMutex;
+std::vector<std::unique_ptr<OwnedThreadLog>> g_threadLogs;
+
+std::tm get_local_time()
+{
+	std::time_t t = std::time(nullptr);
+	std::tm tm;
+#if defined _WIN32
+	localtime_s(&tm, &t);
+#else
+	localtime_r(&t, &tm);
+#endif
+	return tm;
+}
+
+bool is_missing_or_empty(const char* path)
+{
+	std::ifstream file(path);
+	return !file || file.peek() == std::ifstream::traits_type::eof();
+}
+
+// Quotes a field that could contain a comma or quote.
+std::string csv_quote(const char* text)
+{
+	std::string quoted = "\"";
+	for (const char* c = text; *c; ++c)
+	{
+		if (*c == '"')
+		{
+			quoted += '"';
+		}
+		quoted += *c;
+	}
+	quoted += '"';
+	return quoted;
+}
+
+// Escapes a string for a JSON string literal.
+std::string json_escape(const char* text)
+{
+	std::string escaped;
+	for (const char* c = text; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			escaped += '\\';
+			escaped += *c;
+		}
+		else if (static_cast<unsigned char>(*c) < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", *c);
+			escaped += code;
+		}
+		else
+		{
+			escaped += *c;
+		}
+	}
+	return escaped;
+}
+
+template<typename T>
+T median(std::vector<T>& values)
+{
+	std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+} // namespace
 
 //TIMER
-LARGE_INTEGER Timer::sm_frequency = { 0, 0 };
-std::vector<std::tuple<std::string, double, int>> Timer::sm_data;
-int Timer::sm_funcID = 0;
+thread_local Profiler::ThreadLog* Timer::sm_threadLog = nullptr;
+double Timer::sm_ticksPerSecond = 0.0;
+double Timer::sm_scopeOverheadTicks = 0.0;
+double Timer::sm_nestedOverheadTicks = 0.0;
 
-Timer::Timer(const char* name)
-	: m_name(name)
+Profiler::ThreadLog* Timer::create_thread_log()
 {
-	//skip getting freq data if we have it
-	if(sm_frequency.QuadPart == 0)
-		QueryPerformanceFrequency(&sm_frequency);	
-	
-	QueryPerformanceCounter(&m_startTime);
-	
-	//init the data entry and get an id for what we run
-	m_id = sm_data.size();
-	sm_data.push_back(std::make_tuple(m_name, 0.0, sm_funcID));
-	++sm_funcID;
+	std::unique_ptr<OwnedThreadLog> owned(new OwnedThreadLog);
+	owned->m_records.reset(new Profiler::TimerRecord[kTimerRecordsPerThread]);
+
+	std::lock_guard<std::mutex> lock(g_threadLogsMutex);
+	owned->m_log = { owned->m_records.get(), 0, 0, 0, static_cast<uint32_t>(g_threadLogs.size()), nullptr, Profiler::kCountersUnopened };
+	sm_threadLog = &owned->m_log;
+	g_threadLogs.push_back(std::move(owned));
+	return sm_threadLog;
 }
 
-Timer::~Timer()
+void Timer::calibrate()
 {
-	LARGE_INTEGER liET;
-	double dET;
-	//calculate elapsed time microseconds
-	QueryPerformanceCounter(&m_stopTime);
-	liET.QuadPart = m_stopTime.QuadPart - m_startTime.QuadPart;
+	// clock rate, rdtsc ticks at a fixed rate that has to be measured against a known clock.
+#if PROFILER_RDTSC == 1
+	const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+	const uint64_t ticksStart = Profiler::read_ticks();
+	std::chrono::duration<double> elapsed(0);
+	while (elapsed.count() < 0.02)
+	{
+		elapsed = std::chrono::steady_clock::now() - clockStart;
+	}
+	sm_ticksPerSecond = (Profiler::read_ticks() - ticksStart) / elapsed.count();
+#else
+	sm_ticksPerSecond = static_cast<double>(std::chrono::steady_clock::period::den) / std::chrono::steady_clock::period::num;
+#endif
 
-	dET = (double)liET.QuadPart / sm_frequency.QuadPart;
+	// time empty timers into a private log so the calibration leaves no records behind.
+	Profiler::ThreadLog* threadLog = sm_threadLog;
+	std::unique_ptr<Profiler::TimerRecord[]> records(new Profiler::TimerRecord[kTimerRecordsPerThread]);
+	Profiler::ThreadLog calibrationLog = { records.get(), 0, 0, 0, 0, nullptr, Profiler::kCountersUnopened };
+	sm_threadLog = &calibrationLog;
 
-	//add to results
-	std::get<1>(sm_data[m_id]) = dET;
+	std::vector<double> nested;
+	nested.reserve(kCalibrationRounds);
+	for (uint32_t round = 0; round < kCalibrationRounds; ++round)
+	{
+		const uint64_t start = Profiler::read_ticks();
+		for (uint32_t i = 0; i < kCalibrationTimers; ++i)
+		{
+			Timer timer("calibration");
+		}
+		nested.push_back(static_cast<double>(Profiler::read_ticks() - start) / kCalibrationTimers);
+	}
+
+	std::vector<uint64_t> inside;
+	inside.reserve(static_cast<size_t>(calibrationLog.m_written));
+	for (uint64_t i = 0; i < calibrationLog.m_written; ++i)
+	{
+		inside.push_back(records[i].m_elapsedTicks);
+	}
 
-	--sm_funcID;
+	sm_threadLog = threadLog;
+	sm_scopeOverheadTicks = static_cast<double>(median(inside));
+	sm_nestedOverheadTicks = median(nested);
 }
 
 void Timer::output_data()
 {
-	std::vector<std::tuple<int, double, int>> averages;
-	int found = -1;
+	if (sm_ticksPerSecond == 0.0)
+	{
+		calibrate();
+	}
+
+	// (thread, record) for everything still in the rings, the timed threads must have finished.
+	std::vector<std::tuple<uint32_t, Profiler::TimerRecord>> records;
+	uint64_t lostRecords = 0;
+	bool countersRefused = false;
+	{
+		std::lock_guard<std::mutex> lock(g_threadLogsMutex);
+		for (const auto& owned : g_threadLogs)
+		{
+			const Profiler::ThreadLog& log = owned->m_log;
+			countersRefused |= log.m_counterGroup == Profiler::kCountersUnavailable;
+			const uint64_t first = log.m_written > kTimerRecordsPerThread ? log.m_written - kTimerRecordsPerThread : 0;
+			lostRecords += first;
+			for (uint64_t i = first; i < log.m_written; ++i)
+			{
+				records.push_back(std::make_tuple(log.m_threadIndex, log.m_records[i & (kTimerRecordsPerThread - 1)]));
+			}
+		}
+	}
+
+	// scopes are recorded as they close, put them back in the order they opened.
+	std::sort(records.begin(), records.end(),
+		[](const std::tuple<uint32_t, Profiler::TimerRecord>& a, const std::tuple<uint32_t, Profiler::TimerRecord>& b) {
+			return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b) : std::get<1>(a).m_startTicks < std::get<1>(b).m_startTicks; });
 
 	printf("\nLOGGING DATA TO FILE, PLEASE WAIT...\n");
+	printf("Timer overhead %.1fns per scope, %.1fns per nested timer, %llu records lost\n",
+		1.0e9 * sm_scopeOverheadTicks / sm_ticksPerSecond, 1.0e9 * sm_nestedOverheadTicks / sm_ticksPerSecond, static_cast<unsigned long long>(lostRecords));
+	if (countersRefused)
+	{
+		printf("Hardware counters unavailable, perf_event_open was refused\n");
+	}
+
+	const std::tm tm = get_local_time();
+	std::ostringstream runTime;
+	runTime << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+#if defined _DEBUG
+	const char* const build = "Debug";
+#else
+	const char* const build = "Release";
+#endif
 
-	for (const auto& d : sm_data)
+#if CONDENSED_TIMINGS == 0
+	const bool newRawLog = is_missing_or_empty(kRawLogPath);
+	std::ofstream rawlog(kRawLogPath, std::fstream::app);
+	if (newRawLog)
 	{
-		//average for one iteration of scope
-		//find id in averages vec
-		std::for_each(averages.begin(), averages.end(),
-			[&found, &d](std::tuple<int, double, int> t) {
-				if(std::get<0>(t) == std::get<2>(d))
-					found = std::get<0>(t); });
-
-		if (found < 0)
+		rawlog << "run,build,thread,depth,scope,seconds\n";
+	}
+#endif
+
+	// one entry per scope name, in the order the scopes first opened.
+	std::vector<Profiler::ScopeStats> scopes;
+	std::map<std::string, size_t> scopeIndices;
+
+	for (const auto& r : records)
+	{
+		const Profiler::TimerRecord& d = std::get<1>(r);
+
+		// take off the cost of this timer and of every timer nested inside it.
+		const double ticks = std::max(0.0, d.m_elapsedTicks - sm_scopeOverheadTicks - d.m_nestedTimers * sm_nestedOverheadTicks);
+		const double dET = ticks / sm_ticksPerSecond;
+
+		auto found = scopeIndices.find(d.m_name);
+		if (found == scopeIndices.end())
 		{
-			//insert to vector
-			averages.push_back(std::make_tuple(std::get<2>(d), std::get<1>(d), 1));
+			found = scopeIndices.insert(std::make_pair(std::string(d.m_name), scopes.size())).first;
+			scopes.emplace_back(d.m_name);
 		}
-		else
+		Profiler::ScopeStats& stats = scopes[found->second];
+		stats.add(dET * 1.0e9);
+		stats.set_sample_every(d.m_sampleEvery);
+		if (d.m_hasCounters)
 		{
-			//increment average (sum and divide)
-			++std::get<2>(averages.at(found));
-			std::get<1>(averages.at(found)) += std::get<1>(d);
-			std::get<1>(averages.at(found)) /= 2.0;
+			stats.add_counters(d.m_counters);
 		}
 
-		//printf("%s [id: %i]: %d\n", std::get<0>(d).c_str(), std::get<2>(d), std::get<1>(d));
 #if CONDENSED_TIMINGS == 0
-		std::time_t t = std::time(nullptr);
-		std::tm tm; localtime_s(&tm, &t);
-		std::ofstream datalog("datalog.csv", std::fstream::app);
-		datalog << std::put_time(&tm, "%d-%m-%Y %H:%M:%S")
-			<< ", " << std::get<2>(d)
-			<< ", " << std::get<0>(d).c_str()
-			<< ", " << std::fixed << std::setprecision(6) << std::get<1>(d)
-			//<< ", " << dataSize
-			//<< ", " << iterations
-#if defined _DEBUG
-			<< ", Debug"
-#else
-			<< ", Release"
-#endif
-			<< std::endl;
+		rawlog << runTime.str()
+			<< "," << build
+			<< "," << std::get<0>(r)
+			<< "," << d.m_depth
+			<< "," << csv_quote(d.m_name)
+			<< "," << std::fixed << std::setprecision(9) << dET
+			<< "\n";
 #endif
 	}
 
-	for (const auto& a : averages)
+	// one row per scope per run, times in microseconds.
+	const bool newLog = is_missing_or_empty(kLogPath);
+	std::ofstream datalog(kLogPath, std::fstream::app);
+	if (newLog)
 	{
-		std::time_t t = std::time(nullptr);
-		std::tm tm; localtime_s(&tm, &t);
-		std::ofstream datalog("datalog.csv", std::fstream::app);
-		datalog << std::endl
-			<< std::put_time(&tm, "%d-%m-%Y %H:%M:%S")
-			<< ",,,, " << std::get<0>(a)
-			<< ", " << std::fixed << std::setprecision(6) << std::get<1>(a)
-			<< ", RAN " << std::get<2>(a) << " TIMES"
-#if defined _DEBUG
-			<< ", Debug"
-#else
-			<< ", Release"
-#endif
-			<< std::endl;
+		datalog << "run,build,scope,count,total_us,min_us,max_us,mean_us,stddev_us,p50_us,p90_us,p99_us,p99.9_us,sample_every,mean_cycles,mean_instructions,mean_cache_misses\n";
 	}
 
+	for (const Profiler::ScopeStats& s : scopes)
+	{
+		datalog << runTime.str()
+			<< "," << build
+			<< "," << csv_quote(s.get_name().c_str())
+			<< "," << s.get_count()
+			<< std::fixed << std::setprecision(3)
+			<< "," << s.get_total() / 1000.0
+			<< "," << s.get_min() / 1000.0
+			<< "," << s.get_max() / 1000.0
+			<< "," << s.get_mean() / 1000.0
+			<< "," << s.get_stddev() / 1000.0
+			<< "," << s.get_percentile(50.0) / 1000.0
+			<< "," << s.get_percentile(90.0) / 1000.0
+			<< "," << s.get_percentile(99.0) / 1000.0
+			<< "," << s.get_percentile(99.9) / 1000.0
+			<< "," << s.get_sample_every();
+
+		// counter columns stay empty for scopes that never read them.
+		if (s.get_counted() > 0)
+		{
+			datalog << std::setprecision(1)
+				<< "," << s.get_mean_cycles()
+				<< "," << s.get_mean_instructions()
+				<< "," << s.get_mean_cache_misses();
+		}
+		else
+		{
+			datalog << ",,,";
+		}
+		datalog << "\n";
+
+		printf("%-24s %8llu x  mean %10.3fus  p99 %10.3fus  max %10.3fus\n", s.get_name().c_str(),
+			static_cast<unsigned long long>(s.get_count()), s.get_mean() / 1000.0, s.get_percentile(99.0) / 1000.0, s.get_max() / 1000.0);
+	}
+
+#if CHROME_TRACE_OUTPUT == 1
+	output_trace(kTracePath);
+#endif
+
 	printf("\nDATA LOGGED TO FILE, CLOSING...\n");
-}
\ No newline at end of file
+}
+
+void Timer::output_trace(const char* path)
+{
+	if (sm_ticksPerSecond == 0.0)
+	{
+		calibrate();
+	}
+
+	std::lock_guard<std::mutex> lock(g_threadLogsMutex);
+
+	// timestamps are microseconds from the first record still held by any thread.
+	uint64_t originTicks = std::numeric_limits<uint64_t>::max();
+	for (const auto& owned : g_threadLogs)
+	{
+		const Profiler::ThreadLog& log = owned->m_log;
+		const uint64_t first = log.m_written > kTimerRecordsPerThread ? log.m_written - kTimerRecordsPerThread : 0;
+		for (uint64_t i = first; i < log.m_written; ++i)
+		{
+			originTicks = std::min(originTicks, log.m_records[i & (kTimerRecordsPerThread - 1)].m_startTicks);
+		}
+	}
+	const double ticksToUs = 1.0e6 / sm_ticksPerSecond;
+
+	std::ofstream trace(path);
+	trace << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	trace << std::fixed << std::setprecision(3);
+
+	bool firstEvent = true;
+	for (const auto& owned : g_threadLogs)
+	{
+		const Profiler::ThreadLog& log = owned->m_log;
+
+		// metadata event names the track, otherwise it shows as the thread index.
+		trace << (firstEvent ? "" : ",\n")
+			<< "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << log.m_threadIndex
+			<< ",\"args\":{\"name\":\"" << json_escape(log.m_threadName != nullptr ? log.m_threadName : "thread") << " " << log.m_threadIndex << "\"}}";
+		firstEvent = false;
+
+		// complete events, nesting comes from the begin/end times on each thread.
+		const uint64_t first = log.m_written > kTimerRecordsPerThread ? log.m_written - kTimerRecordsPerThread : 0;
+		for (uint64_t i = first; i < log.m_written; ++i)
+		{
+			const Profiler::TimerRecord& d = log.m_records[i & (kTimerRecordsPerThread - 1)];
+			trace << ",\n{\"ph\":\"X\",\"name\":\"" << json_escape(d.m_name)
+				<< "\",\"pid\":1,\"tid\":" << log.m_threadIndex
+				<< ",\"ts\":" << (d.m_startTicks - originTicks) * ticksToUs
+				<< ",\"dur\":" << d.m_elapsedTicks * ticksToUs
+				<< ",\"args\":{\"depth\":" << d.m_depth;
+			if (d.m_hasCounters)
+			{
+				trace << ",\"cycles\":" << d.m_counters.m_cycles
+					<< ",\"instructions\":" << d.m_counters.m_instructions
+					<< ",\"cache_misses\":" << d.m_counters.m_cacheMisses;
+			}
+			trace << "}}";
+		}
+	}
+
+	trace << "\n]}\n";
+	printf("Trace written to %s\n", path);
+}
@@ -2,52 +2,263 @@
 #ifndef PROFILER_H
 #define PROFILER_H
 
+// Instrumentation level, picked at build time:
+//		0 off		every TIMER_ macro compiles to nothing
+//		1 coarse	TIMER_SCOPED / TIMER_START / TIMER_FUNCSTART, per block and per thread stages
+//		2 fine		also TIMER_SCOPED_FINE and TIMER_SAMPLED in hot kernels, with hardware counters
+#define PROFILER_LEVEL_OFF 0
+#define PROFILER_LEVEL_COARSE 1
+#define PROFILER_LEVEL_FINE 2
+#define PROFILER_LEVEL PROFILER_LEVEL_COARSE
+
 #define CONDENSED_TIMINGS 1
+#define CHROME_TRACE_OUTPUT 0	// output_data also writes every record to trace.json for chrome://tracing / Perfetto
+#define PROFILER_USE_RDTSC 1	// read the cpu timestamp counter on x86, steady_clock everywhere else
+#define PROFILER_HW_COUNTERS 1	// fine scopes also read cycles/instructions/cache misses, Linux perf_event_open only
 
-#include <Windows.h>
-#include <vector>
-#include <tuple>
-#include <iostream>
+#include "ProfilerCounters.h"
 #include <cstdint>
-#include <fstream>
-#include <iomanip>
-#include <ctime>
-#include <algorithm>
+#include <chrono>
+#include <new>
+
+#if PROFILER_USE_RDTSC == 1 && (defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__)
+	#define PROFILER_RDTSC 1
+	#if defined _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#else
+	#define PROFILER_RDTSC 0
+#endif
+
+#if PROFILER_LEVEL >= PROFILER_LEVEL_FINE && PROFILER_HW_COUNTERS == 1 && defined __linux__
+	#define PROFILER_COUNTERS 1
+#else
+	#define PROFILER_COUNTERS 0
+#endif
+
+// Completed timer scopes kept per thread, the oldest are overwritten once a thread records more.
+constexpr uint32_t kTimerRecordsPerThread = 1 << 16;
+
+namespace Profiler {
+
+// One completed scope, in raw clock ticks.
+struct TimerRecord
+{
+	const char* m_name;
+	uint64_t m_startTicks;
+	uint64_t m_elapsedTicks;
+	uint32_t m_depth;			// nesting depth on its thread, 0 for outermost
+	uint32_t m_nestedTimers;	// timers started inside this one, their cost is in m_elapsedTicks
+	uint32_t m_sampleEvery;		// 1 unless recorded by TIMER_SAMPLED
+	bool m_hasCounters;
+	CounterValues m_counters;	// deltas over the scope when m_hasCounters
+};
+
+// Preallocated ring of records owned by one thread, only that thread writes it.
+struct ThreadLog
+{
+	TimerRecord* m_records;
+	uint64_t m_written;			// total records, the ring holds the last kTimerRecordsPerThread
+	uint32_t m_depth;
+	uint32_t m_timersStarted;
+	uint32_t m_threadIndex;
+	const char* m_threadName;	// label in trace output, nullptr until named
+	int m_counterGroup;			// perf group, opened by the thread's first counted scope
+};
+
+// Raw clock ticks, see get_ticks_per_second.
+inline uint64_t read_ticks()
+{
+#if PROFILER_RDTSC == 1
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+} // namespace Profiler
 
 //TIMER - logs time within a scope
+// Recording never allocates or locks: each thread gets a ring of records the first time
+// it starts a timer, after that a scope costs two clock reads and a store.
 class Timer
 {
 public:
-	Timer(const char* name);
-	~Timer();
+	Timer(const char* name, bool readCounters = false, uint32_t sampleEvery = 1)
+		: m_name(name)
+		, m_log(get_thread_log())
+		, m_sampleEvery(sampleEvery)
+		, m_hasCounters(false)
+	{
+		m_depth = m_log->m_depth++;
+		m_timersStarted = m_log->m_timersStarted++;
+#if PROFILER_COUNTERS == 1
+		if (readCounters)
+		{
+			if (m_log->m_counterGroup == Profiler::kCountersUnopened)
+			{
+				m_log->m_counterGroup = Profiler::open_thread_counters();
+			}
+			m_hasCounters = Profiler::read_thread_counters(m_log->m_counterGroup, m_startCounters);
+		}
+#else
+		(void)readCounters;
+#endif
+		m_startTicks = Profiler::read_ticks();
+	}
+
+	~Timer()
+	{
+		const uint64_t stopTicks = Profiler::read_ticks();
+		Profiler::CounterValues counters = {};
+#if PROFILER_COUNTERS == 1
+		if (m_hasCounters && Profiler::read_thread_counters(m_log->m_counterGroup, counters))
+		{
+			counters.m_cycles -= m_startCounters.m_cycles;
+			counters.m_instructions -= m_startCounters.m_instructions;
+			counters.m_cacheMisses -= m_startCounters.m_cacheMisses;
+		}
+		else
+		{
+			m_hasCounters = false;
+		}
+#endif
+
+		Profiler::TimerRecord& record = m_log->m_records[m_log->m_written & (kTimerRecordsPerThread - 1)];
+		record.m_name = m_name;
+		record.m_startTicks = m_startTicks;
+		record.m_elapsedTicks = stopTicks - m_startTicks;
+		record.m_depth = m_depth;
+		record.m_nestedTimers = m_log->m_timersStarted - m_timersStarted - 1;
+		record.m_sampleEvery = m_sampleEvery;
+		record.m_hasCounters = m_hasCounters;
+		record.m_counters = counters;
+
+		++m_log->m_written;
+		--m_log->m_depth;
+	}
+
+	// Measures the clock rate and the timers' own cost, output_data calls it if nobody has.
+	static void calibrate();
+
+	// Writes every thread's records, call once the timed threads have finished.
 	static void output_data();
 
+	// Writes every thread's records as Chrome Trace Event JSON, one complete event per scope
+	// with its thread and begin/end time, for chrome://tracing or ui.perfetto.dev.
+	static void output_trace(const char* path);
+
+	// Labels the calling thread in trace output, name must outlive the program.
+	static void set_thread_name(const char* name) { get_thread_log()->m_threadName = name; }
+
 private:
 	//deleted operators & constructors
 	Timer(const Timer&) = delete;
 	Timer& operator=(const Timer&) = delete;
 
-	unsigned m_id;
+	static Profiler::ThreadLog* get_thread_log()
+	{
+		Profiler::ThreadLog* log = sm_threadLog;
+		return log != nullptr ? log : create_thread_log();
+	}
+	static Profiler::ThreadLog* create_thread_log();
+
 	const char* m_name;
-	static int sm_funcID;
+	Profiler::ThreadLog* m_log;
+	uint64_t m_startTicks;
+	uint32_t m_depth;
+	uint32_t m_timersStarted;
+	uint32_t m_sampleEvery;
+	bool m_hasCounters;
+	Profiler::CounterValues m_startCounters;
 
-	LARGE_INTEGER m_startTime;
-	LARGE_INTEGER m_stopTime;
-	static LARGE_INTEGER sm_frequency;
+	static thread_local Profiler::ThreadLog* sm_threadLog;
 
-	static std::vector<std::tuple<std::string, double, int>> sm_data;
+	// filled in by calibrate().
+	static double sm_ticksPerSecond;
+	static double sm_scopeOverheadTicks;	// inside a scope: cost of the clock read pair
+	static double sm_nestedOverheadTicks;	// seen from outside: cost of a whole nested timer
 };
 
+// Times one in every sampleEvery runs of a scope, the others only bump a per thread counter.
+class SampledTimer
+{
+public:
+	SampledTimer(const char* name, uint32_t& counter, uint32_t sampleEvery)
+		: m_active(++counter >= sampleEvery)
+	{
+		if (m_active)
+		{
+			counter = 0;
+			new (m_storage) Timer(name, true, sampleEvery);
+		}
+	}
+
+	~SampledTimer()
+	{
+		if (m_active)
+		{
+			reinterpret_cast<Timer*>(m_storage)->~Timer();
+		}
+	}
+
+private:
+	SampledTimer(const SampledTimer&) = delete;
+	SampledTimer& operator=(const SampledTimer&) = delete;
+
+	bool m_active;
+	alignas(Timer) unsigned char m_storage[sizeof(Timer)];
+};
+
+#define TIMER_CONCAT_INNER(a, b) a##b
+#define TIMER_CONCAT(a, b) TIMER_CONCAT_INNER(a, b)
+
+#if PROFILER_LEVEL >= PROFILER_LEVEL_COARSE
+
 //start stop macros
-#define TIMER_FUNCSTART Timer __xperfstart##__COUNTER__(__FUNCTION__)	//time a function
-#define TIMER_SCOPED(str) Timer __xperfstart##__COUNTER__(str)			//start timing
-#define TIMER_START(str) { Timer __xperfstart##__COUNTER__(str)
+#define TIMER_FUNCSTART Timer TIMER_CONCAT(__xperfstart, __COUNTER__)(__FUNCTION__)	//time a function
+#define TIMER_SCOPED(str) Timer TIMER_CONCAT(__xperfstart, __COUNTER__)(str)			//start timing
+#define TIMER_START(str) { Timer TIMER_CONCAT(__xperfstart, __COUNTER__)(str)
 #define TIMER_END }
+#define TIMER_THREAD_NAME(str) Timer::set_thread_name(str)
 
 //output data macros
-#define TIMER_OUTALL Timer::output_data
+#define TIMER_CALIBRATE() Timer::calibrate()
+#define TIMER_OUTALL() Timer::output_data()
+#define TIMER_OUTTRACE(path) Timer::output_trace(path)
 #define TIMER_OUTALL_ATEXIT atexit(Timer::output_data);
 
-#endif // !PROFILER_H
+#else
+
+#define TIMER_FUNCSTART
+#define TIMER_SCOPED(str)
+#define TIMER_START(str) {
+#define TIMER_END }
+#define TIMER_THREAD_NAME(str) ((void)0)
+
+#define TIMER_CALIBRATE() ((void)0)
+#define TIMER_OUTALL() ((void)0)
+#define TIMER_OUTTRACE(path) ((void)0)
+#define TIMER_OUTALL_ATEXIT
+
+#endif
 
+#if PROFILER_LEVEL >= PROFILER_LEVEL_FINE
 
+// Hot path macros, also read the hardware counters. Counter reads are syscalls and sit
+// outside the scope's own clock reads, but do show up in any coarse scope around them.
+#define TIMER_SCOPED_FINE(str) Timer TIMER_CONCAT(__xperfstart, __COUNTER__)(str, true)
+#define TIMER_SAMPLED(str, every) \
+	static thread_local uint32_t TIMER_CONCAT(__xperfcount, __LINE__) = 0; \
+	SampledTimer TIMER_CONCAT(__xperfsampled, __LINE__)(str, TIMER_CONCAT(__xperfcount, __LINE__), every)
+
+#else
+
+#define TIMER_SCOPED_FINE(str)
+#define TIMER_SAMPLED(str, every)
+
+#endif
+
+#endif // !PROFILER_H
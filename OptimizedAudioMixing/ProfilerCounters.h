@@ -0,0 +1,30 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+
+namespace Profiler {
+
+// Hardware counter readings for the calling thread.
+struct CounterValues
+{
+	uint64_t m_cycles;
+	uint64_t m_instructions;
+	uint64_t m_cacheMisses;
+};
+
+// Handle values besides a real group descriptor.
+constexpr int kCountersUnopened = -1;
+constexpr int kCountersUnavailable = -2;
+
+// Opens a cycles/instructions/cache miss counter group for the calling thread with
+// perf_event_open. Returns kCountersUnavailable off Linux or when the kernel refuses,
+// e.g. perf_event_paranoid or a container without CAP_PERFMON.
+int open_thread_counters();
+
+// Reads the whole group at once, false if the handle is not a counter group.
+bool read_thread_counters(int group, CounterValues& values);
+
+} // namespace Profiler
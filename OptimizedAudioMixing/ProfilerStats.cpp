@@ -0,0 +1,141 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "ProfilerStats.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Profiler {
+
+namespace {
+
+constexpr uint32_t kSubBucketBits = 7;
+constexpr uint32_t kSubBucketCount = 1 << kSubBucketBits;	// exact buckets below this
+constexpr uint32_t kSubBucketHalf = kSubBucketCount / 2;	// linear buckets per power of two above it
+constexpr uint32_t kBucketCount = kSubBucketCount + (64 - kSubBucketBits) * kSubBucketHalf;
+
+uint32_t highest_set_bit(uint64_t value)
+{
+	uint32_t bit = 0;
+	while (value >>= 1)
+	{
+		++bit;
+	}
+	return bit;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+//////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram()
+	: m_counts(kBucketCount, 0)
+	, m_count{ 0 }
+{}
+
+uint32_t LatencyHistogram::bucket_index(uint64_t value)
+{
+	if (value < kSubBucketCount)
+	{
+		return static_cast<uint32_t>(value);
+	}
+
+	// value >> shift lands in [kSubBucketHalf, kSubBucketCount).
+	const uint32_t shift = highest_set_bit(value) - (kSubBucketBits - 1);
+	return kSubBucketCount + (shift - 1) * kSubBucketHalf + static_cast<uint32_t>(value >> shift) - kSubBucketHalf;
+}
+
+uint64_t LatencyHistogram::bucket_highest_value(uint32_t index)
+{
+	if (index < kSubBucketCount)
+	{
+		return index;
+	}
+
+	const uint32_t shift = (index - kSubBucketCount) / kSubBucketHalf + 1;
+	const uint64_t subBucket = (index - kSubBucketCount) % kSubBucketHalf + kSubBucketHalf;
+	const uint64_t next = (subBucket + 1) << shift;
+	return next == 0 ? std::numeric_limits<uint64_t>::max() : next - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+	++m_counts[bucket_index(value)];
+	++m_count;
+}
+
+uint64_t LatencyHistogram::get_percentile(double percentile) const
+{
+	if (m_count == 0)
+	{
+		return 0;
+	}
+
+	// rank of the sample we want, 1 based.
+	const double clamped = std::min(100.0, std::max(0.0, percentile));
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100.0 * m_count)));
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < kBucketCount; ++i)
+	{
+		seen += m_counts[i];
+		if (seen >= rank)
+		{
+			return bucket_highest_value(i);
+		}
+	}
+	return bucket_highest_value(kBucketCount - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ScopeStats
+//////////////////////////////////////////////////////////////////////////
+ScopeStats::ScopeStats(const char* name)
+	: m_name{ name }
+	, m_count{ 0 }
+	, m_total{ 0.0 }
+	, m_min{ std::numeric_limits<double>::max() }
+	, m_max{ 0.0 }
+	, m_mean{ 0.0 }
+	, m_sumSquaredDeviation{ 0.0 }
+	, m_sampleEvery{ 1 }
+	, m_counted{ 0 }
+	, m_counterTotals{ 0, 0, 0 }
+{}
+
+void ScopeStats::add(double ns)
+{
+	++m_count;
+	m_total += ns;
+	m_min = std::min(m_min, ns);
+	m_max = std::max(m_max, ns);
+
+	const double delta = ns - m_mean;
+	m_mean += delta / m_count;
+	m_sumSquaredDeviation += delta * (ns - m_mean);
+
+	m_histogram.record(static_cast<uint64_t>(ns + 0.5));
+}
+
+void ScopeStats::add_counters(const CounterValues& counters)
+{
+	++m_counted;
+	m_counterTotals.m_cycles += counters.m_cycles;
+	m_counterTotals.m_instructions += counters.m_instructions;
+	m_counterTotals.m_cacheMisses += counters.m_cacheMisses;
+}
+
+double ScopeStats::get_stddev() const
+{
+	return m_count > 1 ? std::sqrt(m_sumSquaredDeviation / (m_count - 1)) : 0.0;
+}
+
+double ScopeStats::get_percentile(double percentile) const
+{
+	return std::min(m_max, static_cast<double>(m_histogram.get_percentile(percentile)));
+}
+
+} // namespace Profiler
@@ -0,0 +1,85 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "ProfilerCounters.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Profiler {
+
+// Log-linear histogram of durations in the style of HdrHistogram.
+// Values below 128 get a bucket each, above that every power of two is split into 64 linear
+// sub buckets, so a percentile is reported within 1/64 of the recorded value over the whole
+// 64 bit range with a fixed 30KB of counters.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(uint64_t value);
+
+	uint64_t get_count() const { return m_count; }
+
+	// Smallest value that percentile (0-100) percent of the recorded values are at or below,
+	// reported as the top of its bucket.
+	uint64_t get_percentile(double percentile) const;
+
+private:
+	static uint32_t bucket_index(uint64_t value);
+	static uint64_t bucket_highest_value(uint32_t index);
+
+	std::vector<uint64_t> m_counts;
+	uint64_t m_count;
+};
+
+// Summary of every sample of one timer scope in a run, durations in nanoseconds.
+class ScopeStats
+{
+public:
+	explicit ScopeStats(const char* name);
+
+	void add(double ns);
+
+	// Hardware counter deltas for one sample, only some samples may carry them.
+	void add_counters(const CounterValues& counters);
+
+	// TIMER_SAMPLED scopes only record one run in every sampleEvery.
+	void set_sample_every(uint32_t sampleEvery) { m_sampleEvery = sampleEvery; }
+	uint32_t get_sample_every() const { return m_sampleEvery; }
+
+	const std::string& get_name() const { return m_name; }
+	uint64_t get_count() const { return m_count; }
+	double get_total() const { return m_total; }
+	double get_min() const { return m_min; }
+	double get_max() const { return m_max; }
+	double get_mean() const { return m_mean; }
+	double get_stddev() const;
+
+	// Percentile (0-100) from the histogram, never above the largest sample.
+	double get_percentile(double percentile) const;
+
+	// Means over the samples that carried counters.
+	uint64_t get_counted() const { return m_counted; }
+	double get_mean_cycles() const { return m_counted ? static_cast<double>(m_counterTotals.m_cycles) / m_counted : 0.0; }
+	double get_mean_instructions() const { return m_counted ? static_cast<double>(m_counterTotals.m_instructions) / m_counted : 0.0; }
+	double get_mean_cache_misses() const { return m_counted ? static_cast<double>(m_counterTotals.m_cacheMisses) / m_counted : 0.0; }
+
+private:
+	std::string m_name;
+	uint64_t m_count;
+	double m_total;
+	double m_min;
+	double m_max;
+	double m_mean;
+	double m_sumSquaredDeviation;	// Welford's running M2
+	LatencyHistogram m_histogram;
+
+	uint32_t m_sampleEvery;
+	uint64_t m_counted;
+	CounterValues m_counterTotals;
+};
+
+} // namespace Profiler
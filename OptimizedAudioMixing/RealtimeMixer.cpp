@@ -0,0 +1,146 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "RealtimeMixer.h"
+#include "MixKernels.h"
+#include <algorithm>
+
+namespace Mixer {
+
+//////////////////////////////////////////////////////////////////////////
+// GainMailbox
+//////////////////////////////////////////////////////////////////////////
+GainMailbox::GainMailbox()
+	: m_slots{ nullptr, nullptr, nullptr }
+	, m_numGains{ 0 }
+	, m_latest{ 1 }
+	, m_writeSlot{ 0 }
+	, m_readSlot{ 2 }
+{}
+
+void GainMailbox::init(const float* initialGains, uint32_t numGains)
+{
+	const size_t slotBytes = AlignedArena::aligned_size(numGains * sizeof(float));
+	m_arena.init(slotBytes * 3);
+	for (float*& slot : m_slots)
+	{
+		slot = m_arena.allocate_array<float>(numGains);
+		std::copy(initialGains, initialGains + numGains, slot);
+	}
+
+	m_numGains = numGains;
+	m_writeSlot = 0;
+	m_latest.store(1, std::memory_order_relaxed);
+	m_readSlot = 2;
+}
+
+void GainMailbox::post(const float* gains)
+{
+	std::copy(gains, gains + m_numGains, m_slots[m_writeSlot]);
+
+	// hand our slot over as the latest and take back whichever slot it replaces.
+	const uint32_t previous = m_latest.exchange(m_writeSlot | kFreshFlag, std::memory_order_acq_rel);
+	m_writeSlot = previous & ~kFreshFlag;
+}
+
+const float* GainMailbox::fetch()
+{
+	if (m_latest.load(std::memory_order_relaxed) & kFreshFlag)
+	{
+		const uint32_t latest = m_latest.exchange(m_readSlot, std::memory_order_acq_rel);
+		m_readSlot = latest & ~kFreshFlag;
+	}
+	return m_slots[m_readSlot];
+}
+
+//////////////////////////////////////////////////////////////////////////
+// RealtimeMixer
+//////////////////////////////////////////////////////////////////////////
+RealtimeMixer::RealtimeMixer()
+	: m_numStreams{ 0 }
+	, m_maxFrames{ 0 }
+	, m_streamBuffers{ nullptr }
+	, m_streamStride{ 0 }
+	, m_streamPointers{ nullptr }
+	, m_currentGains{ nullptr }
+	, m_ramps{ nullptr }
+	, m_underrunCount{ 0 }
+{}
+
+void RealtimeMixer::init(uint32_t numStreams, uint32_t maxFrames, uint32_t ringFrames, const float* initialGains)
+{
+	ASSERT(numStreams > 0 && maxFrames > 0 && ringFrames >= maxFrames);
+
+	m_numStreams = numStreams;
+	m_maxFrames = maxFrames;
+
+	m_sources.reset(new SpscRing<float>[numStreams]);
+	for (uint32_t i = 0; i < numStreams; ++i)
+	{
+		m_sources[i].init(static_cast<size_t>(ringFrames) * 2);
+	}
+	m_gains.init(initialGains, numStreams * 2);
+
+	const size_t streamBytes = AlignedArena::aligned_size(static_cast<size_t>(maxFrames) * 2 * sizeof(float));
+	m_arena.init(streamBytes * numStreams + AlignedArena::aligned_size(numStreams * sizeof(float*))
+		+ AlignedArena::aligned_size(numStreams * 2 * sizeof(float)) + AlignedArena::aligned_size(numStreams * sizeof(GainRamp)));
+	m_streamStride = static_cast<uint32_t>(streamBytes / sizeof(float));
+	m_streamBuffers = m_arena.allocate_array<float>(static_cast<size_t>(m_streamStride) * numStreams);
+	m_streamPointers = m_arena.allocate_array<const float*>(numStreams);
+	for (uint32_t i = 0; i < numStreams; ++i)
+	{
+		m_streamPointers[i] = m_streamBuffers + static_cast<size_t>(m_streamStride) * i;
+	}
+	m_currentGains = m_arena.allocate_array<float>(numStreams * 2);
+	std::copy(initialGains, initialGains + numStreams * 2, m_currentGains);
+	m_ramps = m_arena.allocate_array<GainRamp>(numStreams);
+
+	m_underrunCount.store(0, std::memory_order_relaxed);
+}
+
+uint32_t RealtimeMixer::write_source(uint32_t stream, const float* samples, uint32_t numSamples)
+{
+	ASSERT(stream < m_numStreams);
+	return static_cast<uint32_t>(m_sources[stream].push(samples, numSamples));
+}
+
+uint32_t RealtimeMixer::get_source_space(uint32_t stream) const
+{
+	ASSERT(stream < m_numStreams);
+	return static_cast<uint32_t>(m_sources[stream].write_available());
+}
+
+void RealtimeMixer::render(float* out, uint32_t numFrames)
+{
+	ASSERT(numFrames <= m_maxFrames);
+	const uint32_t numSamples = numFrames * 2;
+
+	for (uint32_t i = 0; i < m_numStreams; ++i)
+	{
+		float* buffer = m_streamBuffers + static_cast<size_t>(m_streamStride) * i;
+		const uint32_t popped = static_cast<uint32_t>(m_sources[i].pop(buffer, numSamples));
+		if (popped < numSamples)
+		{
+			std::fill(buffer + popped, buffer + numSamples, 0.0f);
+			m_underrunCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// a gain change is spread over the whole callback, the next one starts on the new gains.
+	const float* gains = m_gains.fetch();
+	if (std::equal(gains, gains + m_numStreams * 2, m_currentGains))
+	{
+		g_mixKernels.m_mixStreams(m_streamPointers, gains, m_numStreams, out, numSamples);
+		return;
+	}
+
+	for (uint32_t i = 0; i < m_numStreams; ++i)
+	{
+		m_ramps[i] = make_gain_ramp(m_currentGains + i * 2, gains + i * 2, numFrames, eRampShape::kLinear);
+	}
+	g_mixKernels.m_mixStreamsRamp(m_streamPointers, m_ramps, m_numStreams, out, numSamples);
+	std::copy(gains, gains + m_numStreams * 2, m_currentGains);
+}
+
+} // namespace Mixer
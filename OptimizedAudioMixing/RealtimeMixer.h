@@ -0,0 +1,97 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "AlignedArena.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <memory>
+
+namespace Mixer {
+
+struct GainRamp;
+
+// Lock free mailbox for a set of gains, one writer thread and one reader thread.
+// A triple buffer: the writer fills its own slot and swaps it in as the latest, the reader
+// swaps the latest out when there is a new one. Neither side waits or sees a torn update.
+class GainMailbox
+{
+public:
+	GainMailbox();
+
+	// Sizes the slots for numGains values and publishes initialGains. Call before either side starts.
+	void init(const float* initialGains, uint32_t numGains);
+
+	// Writer side: publishes a new set of gains, replacing any the reader has not picked up.
+	void post(const float* gains);
+
+	// Reader side: the most recently posted gains, valid until the next fetch.
+	const float* fetch();
+
+	uint32_t get_num_gains() const { return m_numGains; }
+
+private:
+	static constexpr uint32_t kFreshFlag = 4;	// set in m_latest when the writer posted since the last fetch
+
+	AlignedArena m_arena;
+	float* m_slots[3];
+	uint32_t m_numGains;
+
+	std::atomic<uint32_t> m_latest;	// slot index | kFreshFlag
+	uint32_t m_writeSlot;	// writer only
+	uint32_t m_readSlot;	// reader only
+};
+
+// Real time entry point for the mixer.
+// Sources push interleaved stereo samples into one SPSC ring per stream from any thread,
+// gains change through a GainMailbox, and the audio callback calls render() for N frames.
+// render() never locks, allocates or touches a file. A stream that has not been fed enough
+// is padded with silence and counted as an underrun.
+class RealtimeMixer
+{
+public:
+	RealtimeMixer();
+
+	// Sizes everything up front: numStreams rings of ringFrames frames and render
+	// buffers for up to maxFrames frames per callback.
+	void init(uint32_t numStreams, uint32_t maxFrames, uint32_t ringFrames, const float* initialGains);
+
+	uint32_t get_num_streams() const { return m_numStreams; }
+
+	// Source side, one producer thread per stream: queues interleaved stereo samples,
+	// returns how many fitted.
+	uint32_t write_source(uint32_t stream, const float* samples, uint32_t numSamples);
+
+	// Source side: samples that can be queued for a stream without dropping any.
+	uint32_t get_source_space(uint32_t stream) const;
+
+	// Control side, one thread: new Left/Right gain pairs, picked up by the next render(),
+	// which ramps to them across its frames instead of jumping.
+	void post_gains(const float* gains) { m_gains.post(gains); }
+
+	// Audio callback: mixes numFrames stereo frames into out, overwriting it.
+	void render(float* out, uint32_t numFrames);
+
+	// Number of times a stream ran dry inside render().
+	uint64_t get_underrun_count() const { return m_underrunCount.load(std::memory_order_relaxed); }
+
+private:
+	uint32_t m_numStreams;
+	uint32_t m_maxFrames;
+
+	std::unique_ptr<SpscRing<float>[]> m_sources;
+	GainMailbox m_gains;
+
+	AlignedArena m_arena;
+	float* m_streamBuffers;	// numStreams blocks of m_maxFrames stereo frames
+	uint32_t m_streamStride;	// floats between stream blocks
+	const float** m_streamPointers;
+	float* m_currentGains;	// gains the last render() ended on
+	GainRamp* m_ramps;		// per stream, from m_currentGains to newly posted gains
+
+	std::atomic<uint64_t> m_underrunCount;
+};
+
+} // namespace Mixer
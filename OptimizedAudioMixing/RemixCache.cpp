@@ -0,0 +1,429 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "RemixCache.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace Mixer {
+
+namespace {
+
+constexpr uint64_t kHashPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+inline uint64_t rotate_left(uint64_t value, uint32_t bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+	return rotate_left(acc + input * kHashPrime2, 31) * kHashPrime1;
+}
+
+// 64 bit hash of size bytes. Four independent lanes keep it close to memory speed, so hashing
+// a source costs far less than decoding and mixing it.
+uint64_t hash_bytes(const void* data, uint64_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t lanes[4] = { seed + kHashPrime1 + kHashPrime2, seed + kHashPrime2, seed, seed - kHashPrime1 };
+
+	uint64_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i + lane * 8, sizeof(word));
+			lanes[lane] = hash_round(lanes[lane], word);
+		}
+	}
+
+	uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18) + size;
+	for (; i < size; ++i)
+	{
+		hash = rotate_left(hash ^ (bytes[i] * kHashPrime1), 11) * kHashPrime2;
+	}
+
+	hash ^= hash >> 33;
+	hash *= kHashPrime2;
+	hash ^= hash >> 29;
+	hash *= kHashPrime1;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+const char* const kSourceIndexName = "remix_sources.txt";
+
+} // namespace
+
+RemixCache::RemixCache()
+	: m_streamsPerGroup{ 1 }
+	, m_sourceIndexDirty{ false }
+{}
+
+void RemixCache::init(const char* cacheDir, uint32_t streamsPerGroup)
+{
+	ASSERT(streamsPerGroup > 0);
+	m_cacheDir = cacheDir;
+	m_streamsPerGroup = streamsPerGroup;
+	load_source_index();
+}
+
+uint64_t RemixCache::get_source_hash(const char* path, RemixStats& stats)
+{
+	FileStamp stamp;
+	if (!get_file_stamp(path, stamp))
+	{
+		throw WavAudio::WavAudioFileException("Could not open source file.");
+	}
+
+	SourceHash& entry = m_sourceHashes[path];
+	if (entry.m_stamp.m_size != stamp.m_size || entry.m_stamp.m_writeTime != stamp.m_writeTime || entry.m_hash == 0)
+	{
+		entry.m_stamp = stamp;
+		entry.m_hash = get_content_hash(path);
+		m_sourceIndexDirty = true;
+		++stats.m_sourcesHashed;
+	}
+	return entry.m_hash;
+}
+
+uint64_t RemixCache::get_content_hash(const char* path)
+{
+	TIMER_SCOPED("hash source");
+
+	WavAudio::WavAudioFileInput input(path, WavAudio::eInputMode::kMapped);
+	const WavAudio::FmtChunk format = input.get_format();
+	return hash_bytes(input.data_bytes(), input.get_data_size(), hash_bytes(&format, sizeof(format), 0));
+}
+
+std::string RemixCache::get_group_path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "remix_%016llx.wav", static_cast<unsigned long long>(key));
+	return m_cacheDir + "/" + name;
+}
+
+void RemixCache::load_source_index()
+{
+	m_sourceHashes.clear();
+	m_sourceIndexDirty = false;
+
+	// one source per line: size, write time, hash, then the path to the end of the line.
+	std::ifstream index(m_cacheDir + "/" + kSourceIndexName);
+	std::string line;
+	while (std::getline(index, line))
+	{
+		unsigned long long size = 0, writeTime = 0, hash = 0;
+		int pathStart = 0;
+		if (sscanf(line.c_str(), "%llu %llu %llx %n", &size, &writeTime, &hash, &pathStart) == 3 && pathStart > 0)
+		{
+			SourceHash& entry = m_sourceHashes[line.substr(pathStart)];
+			entry.m_stamp.m_size = size;
+			entry.m_stamp.m_writeTime = writeTime;
+			entry.m_hash = hash;
+		}
+	}
+}
+
+void RemixCache::save_source_index() const
+{
+	// a lost index only costs hashing the sources again.
+	const std::string indexPath = m_cacheDir + "/" + kSourceIndexName;
+	const std::string tempPath = indexPath + ".tmp";
+	{
+		std::ofstream index(tempPath, std::ios::trunc);
+		char fields[64];
+		for (const auto& source : m_sourceHashes)
+		{
+			snprintf(fields, sizeof(fields), "%llu %llu %016llx ", static_cast<unsigned long long>(source.second.m_stamp.m_size),
+				static_cast<unsigned long long>(source.second.m_stamp.m_writeTime), static_cast<unsigned long long>(source.second.m_hash));
+			index << fields << source.first << "\n";
+		}
+		if (!index)
+		{
+			return;
+		}
+	}
+	std::remove(indexPath.c_str());
+	std::rename(tempPath.c_str(), indexPath.c_str());
+}
+
+bool RemixCache::is_group_cached(const std::string& path, const WavAudio::FmtChunk& format, uint64_t numSamples)
+{
+	try
+	{
+		WavAudio::WavAudioFileInput group(path.c_str(), WavAudio::eInputMode::kMapped);
+		const WavAudio::FmtChunk groupFormat = group.get_format();
+		return memcmp(&groupFormat, &format, sizeof(format)) == 0 && group.get_samples() == numSamples;
+	}
+	catch (const WavAudio::WavAudioFileException&)
+	{
+		// missing or unreadable, either way it is rendered again.
+		return false;
+	}
+}
+
+std::vector<std::vector<RemixCache::SumNode>> RemixCache::plan_tree(const RenderJob& job, const WavAudio::FmtChunk& format, RemixStats& stats)
+{
+	const uint64_t numSamples = static_cast<uint64_t>(job.m_numBlocks) * job.m_blockSize;
+	const uint32_t fanIn = get_fan_in();
+	std::vector<std::vector<SumNode>> levels(1);
+
+	// leaves: everything a group's sum depends on goes into its key.
+	for (uint32_t first = 0; first < job.m_numStreams; first += m_streamsPerGroup)
+	{
+		const uint32_t numMembers = std::min(m_streamsPerGroup, job.m_numStreams - first);
+
+		std::vector<uint64_t> keyWords;
+		keyWords.push_back(numSamples);
+		keyWords.push_back(hash_bytes(&format, sizeof(format), 0));
+		for (uint32_t s = first; s < first + numMembers; ++s)
+		{
+			uint32_t gainBits[2];
+			memcpy(gainBits, job.m_gains + s * 2, sizeof(gainBits));
+			keyWords.push_back(get_source_hash(job.m_inputPaths[s], stats));
+			keyWords.push_back((static_cast<uint64_t>(gainBits[0]) << 32) | gainBits[1]);
+		}
+
+		const uint64_t key = hash_bytes(keyWords.data(), keyWords.size() * sizeof(uint64_t), 0);
+		levels[0].push_back({ key, get_group_path(key), first, numMembers });
+	}
+
+	// every level above sums fanIn nodes of the one below, keyed by its children's keys.
+	while (levels.back().size() > fanIn)
+	{
+		const std::vector<SumNode>& children = levels.back();
+		std::vector<SumNode> parents;
+		for (uint32_t first = 0; first < children.size(); first += fanIn)
+		{
+			const uint32_t numChildren = std::min(fanIn, static_cast<uint32_t>(children.size()) - first);
+
+			std::vector<uint64_t> keyWords;
+			keyWords.push_back(levels.size());
+			for (uint32_t c = first; c < first + numChildren; ++c)
+			{
+				keyWords.push_back(children[c].m_key);
+			}
+
+			const uint64_t key = hash_bytes(keyWords.data(), keyWords.size() * sizeof(uint64_t), 0);
+			parents.push_back({ key, get_group_path(key), first, numChildren });
+		}
+		levels.push_back(parents);
+	}
+
+	if (m_sourceIndexDirty)
+	{
+		save_source_index();
+		m_sourceIndexDirty = false;
+	}
+	return levels;
+}
+
+void RemixCache::store_sum(const RenderJob& job, const std::string& path, const WavAudio::FmtChunk& format, uint32_t numThreads)
+{
+	// mixed under a temporary name, a render cut short never leaves a file that looks finished.
+	const std::string tempPath = path + ".tmp";
+	{
+		WavAudio::WavAudioFileOutput sumFile(tempPath.c_str(), format);
+		render_parallel(job, sumFile, numThreads);
+	}
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		throw WavAudio::WavAudioFileException("Could not store remix group.");
+	}
+}
+
+RemixStats RemixCache::render(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint32_t numThreads)
+{
+	RemixStats stats = { 0, 0, 0 };
+	const uint64_t numSamples = static_cast<uint64_t>(job.m_numBlocks) * job.m_blockSize;
+	const WavAudio::FmtChunk groupFormat = WavAudio::make_format(WavAudio::eAudioFormat::kFormat_32bitFloat,
+		static_cast<uint16_t>(output.get_channels()), output.get_format().m_samplesPerSec);
+
+	const std::vector<std::vector<SumNode>> levels = plan_tree(job, groupFormat, stats);
+
+	// the sums above the leaves are at the output rate already, summing them is a plain mix at unity gain.
+	const std::vector<float> unityGains(get_fan_in() * 2, 1.0f);
+	std::vector<const char*> childPaths(get_fan_in());
+	RenderJob sumJob = job;
+	sumJob.m_gains = unityGains.data();
+	sumJob.m_inputMode = WavAudio::eInputMode::kMapped;
+
+	// bottom up, so a node's children exist before it is summed. An unchanged node's whole
+	// subtree is unchanged too, only the path from a changed leaf to the top is mixed.
+	for (size_t level = 0; level < levels.size(); ++level)
+	{
+		for (const SumNode& node : levels[level])
+		{
+			if (is_group_cached(node.m_path, groupFormat, numSamples))
+			{
+				++stats.m_groupsReused;
+				continue;
+			}
+
+			if (level == 0)
+			{
+				TIMER_SCOPED("render group");
+				RenderJob groupJob = job;
+				groupJob.m_inputPaths = job.m_inputPaths + node.m_first;
+				groupJob.m_gains = job.m_gains + node.m_first * 2;
+				groupJob.m_numStreams = node.m_count;
+				store_sum(groupJob, node.m_path, groupFormat, numThreads);
+			}
+			else
+			{
+				TIMER_SCOPED("sum groups");
+				for (uint32_t c = 0; c < node.m_count; ++c)
+				{
+					childPaths[c] = levels[level - 1][node.m_first + c].m_path.c_str();
+				}
+				sumJob.m_inputPaths = childPaths.data();
+				sumJob.m_numStreams = node.m_count;
+				store_sum(sumJob, node.m_path, groupFormat, numThreads);
+			}
+			++stats.m_groupsRendered;
+		}
+	}
+
+	// the top level holds at most fan in sums.
+	TIMER_SCOPED("sum groups");
+	const std::vector<SumNode>& top = levels.back();
+	for (uint32_t c = 0; c < top.size(); ++c)
+	{
+		childPaths[c] = top[c].m_path.c_str();
+	}
+	sumJob.m_inputPaths = childPaths.data();
+	sumJob.m_numStreams = static_cast<uint32_t>(top.size());
+	render_parallel(sumJob, output, numThreads);
+
+	return stats;
+}
+
+bool verify_remix_cache(const char* cacheDir, std::ostream& streamOut)
+{
+	// 16 streams in groups of 2 make a tree of 8, 4 and 2 sums. Changing one stem's gain must
+	// mix its leaf and the two sums above it again and reuse the other 11.
+	const uint32_t kNumStreams = 16;
+	const uint32_t kBlockSize = 1024;
+	const uint32_t kNumBlocks = 4;
+	const uint32_t kNumSamples = kBlockSize * kNumBlocks;
+	const uint32_t kChangedStream = 5;
+	const uint32_t kSampleRate = 48000;
+
+	const std::string prefix = std::string(cacheDir) + "/remix_verify_";
+	std::vector<std::string> sourcePaths(kNumStreams);
+	std::vector<const char*> inputPaths(kNumStreams);
+	std::vector<float> samples(kNumSamples);
+	std::vector<float> gains(kNumStreams * 2);
+	for (uint32_t s = 0; s < kNumStreams; ++s)
+	{
+		for (uint32_t i = 0; i < kNumSamples; ++i)
+		{
+			samples[i] = static_cast<float>((i + s * 977) * 2654435761u >> 16) / 65536.0f - 0.5f;
+		}
+		sourcePaths[s] = prefix + std::to_string(s) + ".wav";
+		inputPaths[s] = sourcePaths[s].c_str();
+		WavAudio::WavAudioFileOutput source(inputPaths[s], WavAudio::make_format(WavAudio::eAudioFormat::kFormat_16bitPCM, 2, kSampleRate));
+		source.write(samples.data(), kNumSamples);
+
+		gains[s * 2] = 0.05f + 0.01f * s;
+		gains[s * 2 + 1] = 0.06f - 0.002f * s;
+	}
+	std::vector<float> changedGains = gains;
+	changedGains[kChangedStream * 2] *= 0.5f;
+
+	const RenderJob job = { inputPaths.data(), gains.data(), kNumStreams, kBlockSize, kNumBlocks, WavAudio::eInputMode::kMapped };
+	RenderJob changedJob = job;
+	changedJob.m_gains = changedGains.data();
+
+	RemixCache cache;
+	cache.init(cacheDir, 2);
+
+	// sums left by an earlier run would be reused, start both jobs from an empty cache.
+	const WavAudio::FmtChunk sumFormat = WavAudio::make_format(WavAudio::eAudioFormat::kFormat_32bitFloat, 2, kSampleRate);
+	std::vector<std::string> sumPaths;
+	RemixStats planStats = { 0, 0, 0 };
+	const RenderJob* plannedJobs[] = { &job, &changedJob };
+	for (const RenderJob* plannedJob : plannedJobs)
+	{
+		for (const std::vector<RemixCache::SumNode>& level : cache.plan_tree(*plannedJob, sumFormat, planStats))
+		{
+			for (const RemixCache::SumNode& node : level)
+			{
+				std::remove(node.m_path.c_str());
+				sumPaths.push_back(node.m_path);
+			}
+		}
+	}
+
+	const std::string outputPath = prefix + "out.wav";
+	const std::string referencePath = prefix + "reference.wav";
+	auto render_remix = [&](const RenderJob& remixJob)
+	{
+		WavAudio::WavAudioFileOutput output(outputPath.c_str(), sumFormat);
+		return cache.render(remixJob, output, 1);
+	};
+	auto check_stats = [&](const char* name, const RemixStats& stats, uint32_t reused, uint32_t rendered)
+	{
+		if (stats.m_groupsReused == reused && stats.m_groupsRendered == rendered)
+		{
+			return true;
+		}
+		streamOut << "remix cache " << name << ": reused " << stats.m_groupsReused << " rendered " << stats.m_groupsRendered
+			<< ", expected " << reused << " and " << rendered << std::endl;
+		return false;
+	};
+
+	bool ok = true;
+	ok &= check_stats("first render", render_remix(job), 0, 14);
+	ok &= check_stats("same render", render_remix(job), 14, 0);
+	ok &= check_stats("one stem changed", render_remix(changedJob), 11, 3);
+
+	// the sum of sums against a direct mix of the changed job.
+	{
+		WavAudio::WavAudioFileOutput reference(referencePath.c_str(), sumFormat);
+		render_parallel(changedJob, reference, 1);
+	}
+	{
+		std::vector<float> expected(kNumSamples), actual(kNumSamples);
+		WavAudio::WavAudioFileInput reference(referencePath.c_str(), WavAudio::eInputMode::kMapped);
+		WavAudio::WavAudioFileInput output(outputPath.c_str(), WavAudio::eInputMode::kMapped);
+		reference.read(expected.data(), kNumSamples);
+		output.read(actual.data(), kNumSamples);
+		for (uint32_t i = 0; i < kNumSamples; ++i)
+		{
+			if (std::abs(expected[i] - actual[i]) > 1e-5f)
+			{
+				streamOut << "remix cache sum differs from render_parallel at sample " << i << std::endl;
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	for (const std::string& path : sourcePaths)
+	{
+		std::remove(path.c_str());
+		cache.m_sourceHashes.erase(path);
+	}
+	for (const std::string& path : sumPaths)
+	{
+		std::remove(path.c_str());
+	}
+	std::remove(outputPath.c_str());
+	std::remove(referencePath.c_str());
+	cache.save_source_index();
+	return ok;
+}
+
+} // namespace Mixer
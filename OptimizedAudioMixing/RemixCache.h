@@ -0,0 +1,106 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "ParallelRender.h"
+#include "WaveFile.h"
+#include "MappedFile.h"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Mixer {
+
+// What one RemixCache::render did.
+struct RemixStats
+{
+	uint32_t m_groupsReused;	// sums at any level of the tree found in the cache
+	uint32_t m_groupsRendered;	// sums mixed again, from their sources or the sums below
+	uint32_t m_sourcesHashed;	// sources read to hash their content, the rest were unchanged on disk
+};
+
+// Incremental re-mixing for revisions of the same job.
+// Streams are split into groups in job order and each group's mix is kept as a 32 bit float
+// wav file in the cache directory. The file is named after a hash of everything the sum
+// depends on: the content of each member's source file, its L/R gains, the output rate and
+// the length. The group sums are the leaves of a tree: each level above sums groups of the
+// sums below and is cached the same way, keyed by its children's keys, until a level is
+// small enough to sum into the output. Changing one stem's gain therefore mixes one group,
+// then one sum per level on the way up, and the final pass only reads the top level,
+// instead of decoding and mixing every stream.
+// Source hashes are kept in an index next to the group files, keyed by path, size and write
+// time, so only sources that changed on disk are read to hash them.
+// The sum of group sums can differ from render_parallel in the last bit of a float.
+// Group files are never deleted, so going back to an earlier revision still finds them.
+class RemixCache
+{
+public:
+	RemixCache();
+
+	// cacheDir must already exist.
+	void init(const char* cacheDir, uint32_t streamsPerGroup);
+
+	// Renders job into an open output without write behind, with render_parallel and
+	// numThreads workers. A source is only hashed again if its size or write time changed.
+	RemixStats render(const RenderJob& job, WavAudio::WavAudioFileOutput& output, uint32_t numThreads);
+
+private:
+	friend bool verify_remix_cache(const char* cacheDir, std::ostream& streamOut);
+
+	// One cached sum, of m_count streams from m_first at the leaves, or m_count sums from
+	// m_first in the level below.
+	struct SumNode
+	{
+		uint64_t m_key;
+		std::string m_path;
+		uint32_t m_first;
+		uint32_t m_count;
+	};
+
+	// Sums each node of the levels above the leaves is made from, at least 2.
+	uint32_t get_fan_in() const { return std::max(m_streamsPerGroup, 2u); }
+
+	// Keys and paths of every sum a job needs, leaves first. Nothing is mixed.
+	std::vector<std::vector<SumNode>> plan_tree(const RenderJob& job, const WavAudio::FmtChunk& format, RemixStats& stats);
+
+	// Renders job into a new sum file at path.
+	static void store_sum(const RenderJob& job, const std::string& path, const WavAudio::FmtChunk& format, uint32_t numThreads);
+
+	// Content hash of a source and the version of the file it was taken from.
+	struct SourceHash
+	{
+		FileStamp m_stamp;
+		uint64_t m_hash;
+	};
+
+	// Hash of a source file's format and audio data, from the index while the file is unchanged.
+	uint64_t get_source_hash(const char* path, RemixStats& stats);
+
+	// Hash of a source file's format and audio data.
+	static uint64_t get_content_hash(const char* path);
+
+	// The source index lives in the cache directory next to the group sums.
+	void load_source_index();
+	void save_source_index() const;
+
+	std::string get_group_path(uint64_t key) const;
+
+	// True if path holds a finished group sum of numSamples samples in format.
+	static bool is_group_cached(const std::string& path, const WavAudio::FmtChunk& format, uint64_t numSamples);
+
+	std::string m_cacheDir;
+	uint32_t m_streamsPerGroup;
+	std::map<std::string, SourceHash> m_sourceHashes;	// by source path
+	bool m_sourceIndexDirty;
+};
+
+// Renders a set of generated sources through a fresh part of the cache in cacheDir, checks
+// that a repeat reuses every sum and that changing one stem's gain only mixes the sums on
+// its path to the top, and compares the result with render_parallel. Removes its files after.
+// Returns false and reports what differed.
+bool verify_remix_cache(const char* cacheDir, std::ostream& streamOut);
+
+} // namespace Mixer
@@ -0,0 +1,308 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Resampler.h"
+#include "PcmCodecs.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <immintrin.h>
+
+namespace WavAudio {
+
+// Every phase of the filter for one L/M ratio, each phase's taps stored oldest input first.
+struct ResamplerFilterBank
+{
+	uint32_t m_upFactor;	// L
+	uint32_t m_downFactor;	// M
+	std::vector<float> m_coefficients;	// L phases of kResamplerTaps
+
+	const float* get_phase(uint32_t phase) const { return m_coefficients.data() + static_cast<size_t>(phase) * kResamplerTaps; }
+};
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kPassband = 0.91;	// cutoff as a fraction of the lower Nyquist rate
+constexpr double kKaiserBeta = 8.0;
+
+// Output frames lag the input by half the filter, the newest tap is this far ahead.
+constexpr uint32_t kFilterDelay = kResamplerTaps / 2;
+
+uint32_t greatest_common_divisor(uint32_t a, uint32_t b)
+{
+	while (b != 0)
+	{
+		const uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (uint32_t k = 1; k < 32; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+std::shared_ptr<const ResamplerFilterBank> build_filter_bank(uint32_t upFactor, uint32_t downFactor)
+{
+	std::shared_ptr<ResamplerFilterBank> bank = std::make_shared<ResamplerFilterBank>();
+	bank->m_upFactor = upFactor;
+	bank->m_downFactor = downFactor;
+	bank->m_coefficients.resize(static_cast<size_t>(upFactor) * kResamplerTaps);
+
+	// Prototype low pass at the upsampled rate, cutoff below the lower of the two Nyquist rates,
+	// gain L to make up for the zeros stuffed between input samples.
+	// The centre sits on tap kFilterDelay * L so the output lines up with the input frame
+	// kFilterDelay behind the newest, the first tap is the window's zero.
+	const uint32_t length = upFactor * kResamplerTaps;
+	const double cutoff = kPassband * 0.5 / std::max(upFactor, downFactor);
+	const double centre = static_cast<double>(upFactor) * kFilterDelay;
+	const double windowScale = 1.0 / bessel_i0(kKaiserBeta);
+	for (uint32_t j = 0; j < length; ++j)
+	{
+		const double t = j - centre;
+		const double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * kPi * cutoff * t) / (2.0 * kPi * cutoff * t);
+		const double ratio = t / centre;
+		const double window = bessel_i0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) * windowScale;
+		const double h = upFactor * 2.0 * cutoff * sinc * window;
+
+		// tap j belongs to phase j % L and input frame j / L back from the newest.
+		const uint32_t phase = j % upFactor;
+		const uint32_t back = j / upFactor;
+		bank->m_coefficients[static_cast<size_t>(phase) * kResamplerTaps + (kResamplerTaps - 1 - back)] = static_cast<float>(h);
+	}
+	return bank;
+}
+
+// Banks are shared between resamplers with the same ratio, only built during init.
+std::shared_ptr<const ResamplerFilterBank> get_filter_bank(uint32_t upFactor, uint32_t downFactor)
+{
+	static std::mutex s_mutex;
+	static std::vector<std::shared_ptr<const ResamplerFilterBank>> s_banks;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (const std::shared_ptr<const ResamplerFilterBank>& bank : s_banks)
+	{
+		if (bank->m_upFactor == upFactor && bank->m_downFactor == downFactor)
+		{
+			return bank;
+		}
+	}
+	s_banks.push_back(build_filter_bank(upFactor, downFactor));
+	return s_banks.back();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// kResamplerTaps long dot products.
+//////////////////////////////////////////////////////////////////////////
+float dot_scalar(const float* a, const float* b)
+{
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < kResamplerTaps; ++i)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+float dot_sse(const float* a, const float* b)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (uint32_t i = 0; i < kResamplerTaps; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	__m128 sum = _mm_add_ps(acc0, acc1);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+TARGET_AVX2 float dot_avx2(const float* a, const float* b)
+{
+	// two accumulators so consecutive fmas do not wait on each other.
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	for (uint32_t i = 0; i < kResamplerTaps; i += 16)
+	{
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+	}
+	const __m256 acc = _mm256_add_ps(acc0, acc1);
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+TARGET_AVX512 float dot_avx512(const float* a, const float* b)
+{
+	__m512 acc = _mm512_setzero_ps();
+	for (uint32_t i = 0; i < kResamplerTaps; i += 16)
+	{
+		acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+	}
+	return _mm512_reduce_add_ps(acc);
+}
+
+} // namespace
+
+Resampler::Resampler()
+	: m_dot{ dot_scalar }
+	, m_inRate{ 0 }
+	, m_outRate{ 0 }
+	, m_numChannels{ 0 }
+	, m_maxOutFrames{ 0 }
+	, m_capacity{ 0 }
+	, m_history{ nullptr }
+	, m_bufferedFrames{ 0 }
+	, m_index{ 0 }
+	, m_phase{ 0 }
+{}
+
+bool Resampler::is_ratio_supported(uint32_t inRate, uint32_t outRate)
+{
+	if (inRate == 0 || outRate == 0)
+	{
+		return false;
+	}
+
+	// the history is trimmed after every block, which needs each output step to stay inside the filter.
+	const uint32_t divisor = greatest_common_divisor(inRate, outRate);
+	const uint32_t upFactor = outRate / divisor;
+	const uint32_t downFactor = inRate / divisor;
+	return upFactor <= kMaxResamplerPhases && downFactor <= upFactor * (kResamplerTaps / 2);
+}
+
+void Resampler::init(uint32_t inRate, uint32_t outRate, uint32_t numChannels, uint32_t maxOutFrames, eKernelIsa isa)
+{
+	ASSERT(is_ratio_supported(inRate, outRate) && numChannels > 0 && numChannels <= kMaxResamplerChannels);
+
+	const uint32_t divisor = greatest_common_divisor(inRate, outRate);
+	m_bank = get_filter_bank(outRate / divisor, inRate / divisor);
+
+	switch (isa)
+	{
+	case eKernelIsa::kSSE: m_dot = dot_sse; break;
+	case eKernelIsa::kAVX2: m_dot = dot_avx2; break;
+	case eKernelIsa::kAVX512: m_dot = dot_avx512; break;
+	default: m_dot = dot_scalar; break;
+	}
+
+	m_inRate = inRate;
+	m_outRate = outRate;
+	m_numChannels = numChannels;
+	m_maxOutFrames = maxOutFrames;
+
+	// the filter history plus the most input one block of output can need.
+	const uint64_t maxInFrames = static_cast<uint64_t>(maxOutFrames) * m_bank->m_downFactor / m_bank->m_upFactor + 2;
+	m_capacity = static_cast<uint32_t>(kResamplerTaps + kFilterDelay + maxInFrames);
+
+	const size_t planeBytes = AlignedArena::aligned_size(static_cast<size_t>(m_capacity) * sizeof(float));
+	m_arena.init(AlignedArena::aligned_size(numChannels * sizeof(float*)) + planeBytes * numChannels);
+	m_history = m_arena.allocate_array<float*>(numChannels);
+	for (uint32_t c = 0; c < numChannels; ++c)
+	{
+		m_history[c] = m_arena.allocate_array<float>(m_capacity);
+	}
+
+	seek(0);
+}
+
+uint64_t Resampler::seek(uint64_t outFrame)
+{
+	const uint64_t position = outFrame * m_bank->m_downFactor;
+	const int64_t newest = static_cast<int64_t>(position / m_bank->m_upFactor) + kFilterDelay;
+	const int64_t oldest = newest - (kResamplerTaps - 1);
+
+	// frames before the input starts are buffered as silence.
+	m_bufferedFrames = oldest < 0 ? static_cast<uint32_t>(-oldest) : 0;
+	for (uint32_t c = 0; c < m_numChannels; ++c)
+	{
+		std::fill(m_history[c], m_history[c] + m_bufferedFrames, 0.0f);
+	}
+	m_index = kResamplerTaps - 1;
+	m_phase = static_cast<uint32_t>(position % m_bank->m_upFactor);
+
+	return oldest < 0 ? 0 : static_cast<uint64_t>(oldest);
+}
+
+uint32_t Resampler::get_input_frames_needed(uint32_t numOutFrames) const
+{
+	if (numOutFrames == 0)
+	{
+		return 0;
+	}
+
+	const uint64_t steps = m_phase + static_cast<uint64_t>(numOutFrames - 1) * m_bank->m_downFactor;
+	const uint64_t newest = m_index + steps / m_bank->m_upFactor;
+	return newest < m_bufferedFrames ? 0 : static_cast<uint32_t>(newest + 1 - m_bufferedFrames);
+}
+
+void Resampler::process(const float* in, uint32_t numInFrames, float* out, uint32_t numOutFrames)
+{
+	TIMER_SCOPED_FINE("resample block");
+	ASSERT(numOutFrames <= m_maxOutFrames && numInFrames == get_input_frames_needed(numOutFrames));
+	ASSERT(m_bufferedFrames + numInFrames <= m_capacity);
+
+	// append the new frames to each channel's history.
+	float* planes[kMaxResamplerChannels];
+	for (uint32_t c = 0; c < m_numChannels; ++c)
+	{
+		planes[c] = m_history[c] + m_bufferedFrames;
+	}
+	deinterleave(in, planes, m_numChannels, numInFrames);
+	m_bufferedFrames += numInFrames;
+
+	const uint32_t upFactor = m_bank->m_upFactor;
+	const uint32_t downFactor = m_bank->m_downFactor;
+	for (uint32_t n = 0; n < numOutFrames; ++n)
+	{
+		const float* coefficients = m_bank->get_phase(m_phase);
+		const uint32_t oldest = m_index - (kResamplerTaps - 1);
+		for (uint32_t c = 0; c < m_numChannels; ++c)
+		{
+			out[n * m_numChannels + c] = m_dot(coefficients, m_history[c] + oldest);
+		}
+
+		m_phase += downFactor;
+		m_index += m_phase / upFactor;
+		m_phase %= upFactor;
+	}
+
+	// keep only the history the next output still reaches back to, is_ratio_supported
+	// keeps a step between outputs short enough that this never passes the buffered frames.
+	const uint32_t discard = m_index - (kResamplerTaps - 1);
+	if (discard > 0)
+	{
+		for (uint32_t c = 0; c < m_numChannels; ++c)
+		{
+			memmove(m_history[c], m_history[c] + discard, (m_bufferedFrames - discard) * sizeof(float));
+		}
+		m_bufferedFrames -= discard;
+		m_index -= discard;
+	}
+}
+
+uint64_t Resampler::get_output_frames(uint64_t numInFrames) const
+{
+	return numInFrames * m_bank->m_upFactor / m_bank->m_downFactor;
+}
+
+} // namespace WavAudio
@@ -0,0 +1,82 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "CpuFeatures.h"
+#include "AlignedArena.h"
+#include <memory>
+
+namespace WavAudio {
+
+struct ResamplerFilterBank;
+
+// Filter taps per output sample, a multiple of the widest vector.
+constexpr uint32_t kResamplerTaps = 32;
+
+// Most phases (the reduced L of out/in = L/M) a filter bank is built with.
+constexpr uint32_t kMaxResamplerPhases = 1024;
+
+// Widest layout a resampler converts, 7.1.
+constexpr uint32_t kMaxResamplerChannels = 8;
+
+// Streaming sample rate converter for interleaved float audio.
+// The rate ratio is reduced to out/in = L/M and output frame n is the dot product of
+// kResamplerTaps input frames with phase (n * M) % L of a windowed sinc filter bank.
+// Banks are built once per ratio and shared by every resampler using it. Output is
+// pulled: ask how many input frames the next block needs, then hand exactly those over.
+class Resampler
+{
+public:
+	Resampler();
+
+	// False if the ratio needs more than kMaxResamplerPhases phases or reduces by more
+	// than the filter length allows.
+	static bool is_ratio_supported(uint32_t inRate, uint32_t outRate);
+
+	// Sizes the history for blocks of up to maxOutFrames and seeks to output frame 0.
+	// isa picks the dot product width, the widest the host supports by default.
+	void init(uint32_t inRate, uint32_t outRate, uint32_t numChannels, uint32_t maxOutFrames, eKernelIsa isa = get_best_kernel_isa());
+
+	bool is_initialised() const { return m_bank != nullptr; }
+
+	// Restarts the stream at outFrame. Returns the input frame the next process call must
+	// start reading from, frames before the start of the input are treated as silence.
+	uint64_t seek(uint64_t outFrame);
+
+	// Input frames the next numOutFrames output frames need on top of the buffered history.
+	uint32_t get_input_frames_needed(uint32_t numOutFrames) const;
+
+	// in holds exactly get_input_frames_needed(numOutFrames) interleaved frames.
+	void process(const float* in, uint32_t numInFrames, float* out, uint32_t numOutFrames);
+
+	// Output frames a whole input of numInFrames frames turns into.
+	uint64_t get_output_frames(uint64_t numInFrames) const;
+
+	// Most input frames a process call of up to maxOutFrames can need.
+	uint32_t get_max_input_frames() const { return m_capacity; }
+
+	uint32_t get_in_rate() const { return m_inRate; }
+	uint32_t get_out_rate() const { return m_outRate; }
+
+private:
+	typedef float (*DotProductFunc)(const float* a, const float* b);
+
+	std::shared_ptr<const ResamplerFilterBank> m_bank;
+	DotProductFunc m_dot;
+	AlignedArena m_arena;
+
+	uint32_t m_inRate;
+	uint32_t m_outRate;
+	uint32_t m_numChannels;
+	uint32_t m_maxOutFrames;
+	uint32_t m_capacity;		// frames each history plane holds
+	float** m_history;			// a plane per channel
+
+	uint32_t m_bufferedFrames;	// frames of history in the planes
+	uint32_t m_index;			// newest history frame the next output uses
+	uint32_t m_phase;			// filter phase of the next output, [0, L)
+};
+
+} // namespace WavAudio
@@ -0,0 +1,102 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "AlignedArena.h"
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+// Lock free single producer, single consumer ring of trivially copyable values.
+// One thread may push and one other thread may pop, neither ever blocks or allocates.
+// The capacity is rounded up to a power of two so the indices can run freely and wrap.
+template<typename T>
+class SpscRing
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SpscRing copies values with memcpy semantics");
+
+public:
+	SpscRing()
+		: m_buffer{ nullptr }
+		, m_mask{ 0 }
+		, m_writeIndex{ 0 }
+		, m_readIndex{ 0 }
+	{}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator = (const SpscRing&) = delete;
+
+	// Sizes the ring for at least capacity values. Not thread safe, call before either side starts.
+	void init(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+
+		m_arena.init(AlignedArena::aligned_size(size * sizeof(T)));
+		m_buffer = m_arena.allocate_array<T>(size);
+		m_mask = size - 1;
+		m_writeIndex.store(0, std::memory_order_relaxed);
+		m_readIndex.store(0, std::memory_order_relaxed);
+	}
+
+	size_t get_capacity() const { return m_mask + 1; }
+
+	// Producer side: values that can be pushed right now.
+	size_t write_available() const
+	{
+		return get_capacity() - (m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_acquire));
+	}
+
+	// Consumer side: values that can be popped right now.
+	size_t read_available() const
+	{
+		return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed);
+	}
+
+	// Pushes up to count values, returns how many fit.
+	size_t push(const T* values, size_t count)
+	{
+		const size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		count = std::min(count, get_capacity() - (writeIndex - m_readIndex.load(std::memory_order_acquire)));
+
+		// the free space may wrap around the end of the buffer.
+		const size_t start = writeIndex & m_mask;
+		const size_t first = std::min(count, get_capacity() - start);
+		std::copy(values, values + first, m_buffer + start);
+		std::copy(values + first, values + count, m_buffer);
+
+		m_writeIndex.store(writeIndex + count, std::memory_order_release);
+		return count;
+	}
+
+	// Pops up to count values, returns how many were available.
+	size_t pop(T* values, size_t count)
+	{
+		const size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+		count = std::min(count, m_writeIndex.load(std::memory_order_acquire) - readIndex);
+
+		const size_t start = readIndex & m_mask;
+		const size_t first = std::min(count, get_capacity() - start);
+		std::copy(m_buffer + start, m_buffer + start + first, values);
+		std::copy(m_buffer, m_buffer + (count - first), values + first);
+
+		m_readIndex.store(readIndex + count, std::memory_order_release);
+		return count;
+	}
+
+private:
+	AlignedArena m_arena;
+	T* m_buffer;
+	size_t m_mask;
+
+	// padded so the two indices never share a cache line, rings are often
+	// allocated in arrays where alignas would need over aligned new.
+	std::atomic<size_t> m_writeIndex;
+	uint8_t m_pad[kArenaAlignment];
+	std::atomic<size_t> m_readIndex;
+};
@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "StreamParallelMixer.h"
+#include "MixKernels.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace Mixer {
+
+StreamParallelMixer::StreamParallelMixer()
+	: m_pool{ nullptr }
+	, m_numStreams{ 0 }
+	, m_streamsPerGroup{ 0 }
+	, m_numGroups{ 0 }
+	, m_maxBlockSize{ 0 }
+	, m_partials{ nullptr }
+	, m_ins{ nullptr }
+	, m_gains{ nullptr }
+	, m_blockSize{ 0 }
+	, m_reduceStride{ 0 }
+{}
+
+void StreamParallelMixer::init(WorkStealingPool& pool, uint32_t numStreams, uint32_t streamsPerGroup, uint32_t blockSize)
+{
+	ASSERT(numStreams > 0 && streamsPerGroup > 0);
+
+	m_pool = &pool;
+	m_numStreams = numStreams;
+	m_streamsPerGroup = std::min(streamsPerGroup, numStreams);
+	m_numGroups = (numStreams + m_streamsPerGroup - 1) / m_streamsPerGroup;
+	m_maxBlockSize = blockSize;
+
+	const size_t partialBytes = AlignedArena::aligned_size(static_cast<size_t>(blockSize) * sizeof(float));
+	m_arena.init(AlignedArena::aligned_size(m_numGroups * sizeof(float*)) + partialBytes * (m_numGroups - 1));
+	m_partials = m_arena.allocate_array<float*>(m_numGroups);
+	m_partials[0] = nullptr;
+	for (uint32_t i = 1; i < m_numGroups; ++i)
+	{
+		m_partials[i] = m_arena.allocate_array<float>(blockSize);
+	}
+}
+
+void StreamParallelMixer::mix(const float* const* ins, const float* gains, float* out, uint32_t blockSize)
+{
+	ASSERT(m_pool != nullptr && blockSize <= m_maxBlockSize);
+
+	m_ins = ins;
+	m_gains = gains;
+	m_blockSize = blockSize;
+
+	// group 0 mixes straight into out, so the tree ends there without a copy.
+	m_partials[0] = out;
+	m_pool->run(&StreamParallelMixer::mix_group_task, this, m_numGroups);
+
+	// pass s adds partial i + s into partial i for every i that is a multiple of 2s.
+	for (m_reduceStride = 1; m_reduceStride < m_numGroups; m_reduceStride *= 2)
+	{
+		const uint32_t numPairs = (m_numGroups - m_reduceStride + 2 * m_reduceStride - 1) / (2 * m_reduceStride);
+		m_pool->run(&StreamParallelMixer::reduce_task, this, numPairs);
+	}
+}
+
+void StreamParallelMixer::mix_group_task(void* context, uint32_t group)
+{
+	StreamParallelMixer& mixer = *static_cast<StreamParallelMixer*>(context);
+	TIMER_SCOPED_FINE("mix group");
+
+	const uint32_t first = group * mixer.m_streamsPerGroup;
+	const uint32_t count = std::min(mixer.m_streamsPerGroup, mixer.m_numStreams - first);
+	g_mixKernels.m_mixStreams(mixer.m_ins + first, mixer.m_gains + first * 2, count, mixer.m_partials[group], mixer.m_blockSize);
+}
+
+void StreamParallelMixer::reduce_task(void* context, uint32_t pair)
+{
+	StreamParallelMixer& mixer = *static_cast<StreamParallelMixer*>(context);
+	TIMER_SCOPED_FINE("reduce pair");
+
+	const uint32_t target = pair * 2 * mixer.m_reduceStride;
+	g_mixKernels.m_mixBuffer(mixer.m_partials[target + mixer.m_reduceStride], mixer.m_partials[target], 1.0f, 1.0f, mixer.m_blockSize);
+}
+
+} // namespace Mixer
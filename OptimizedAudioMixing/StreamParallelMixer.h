@@ -0,0 +1,57 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include "AlignedArena.h"
+#include "WorkStealingPool.h"
+
+namespace Mixer {
+
+// Mixes a large number of streams into one block across a WorkStealingPool.
+// The streams are split into groups of streamsPerGroup, every group is mixed into its own
+// partial sum buffer with mix_streams, then the partials are added pairwise in a tree
+// (log2 groups passes) into the output, so the critical path shrinks as cores are added.
+//
+// Tolerance: within a group the sum is formed exactly as mix_streams forms it, only the
+// order the group partials are added in changes. Against a serial left to right sum of
+// all numStreams terms the result differs by at most
+//		(numStreams + log2(numGroups)) * 2^-24 * sum(|gain * sample|)
+// per output sample. For 256 streams whose |gain * sample| terms add up to at most 1 that is
+// under half a 16 bit LSB. Results are deterministic for a given group size.
+class StreamParallelMixer
+{
+public:
+	StreamParallelMixer();
+
+	// Sizes the partial sum buffers for numStreams inputs of up to blockSize samples.
+	void init(WorkStealingPool& pool, uint32_t numStreams, uint32_t streamsPerGroup, uint32_t blockSize);
+
+	// Same contract as MixStreamsFunc for the numStreams given to init, out is overwritten.
+	void mix(const float* const* ins, const float* gains, float* out, uint32_t blockSize);
+
+	uint32_t get_num_groups() const { return m_numGroups; }
+
+private:
+	static void mix_group_task(void* context, uint32_t group);
+	static void reduce_task(void* context, uint32_t pair);
+
+	WorkStealingPool* m_pool;
+	AlignedArena m_arena;
+
+	uint32_t m_numStreams;
+	uint32_t m_streamsPerGroup;
+	uint32_t m_numGroups;
+	uint32_t m_maxBlockSize;
+
+	float** m_partials;	// one per group, the first is the caller's output
+
+	// current mix() call, read by the tasks.
+	const float* const* m_ins;
+	const float* m_gains;
+	uint32_t m_blockSize;
+	uint32_t m_reduceStride;
+};
+
+} // namespace Mixer
@@ -3,6 +3,11 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "WaveFile.h"
+#include "PcmCodecs.h"
+#include "AlignedArena.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace WavAudio {
@@ -25,7 +30,11 @@ namespace ChunkId{
 enum eChunkId : uint32_t
 {
 	kRiff = make_riff_fourcc("RIFF")
+	, kRf64 = make_riff_fourcc("RF64")
+	, kBw64 = make_riff_fourcc("BW64")
 	, kWave = make_riff_fourcc("WAVE")
+	, kDs64 = make_riff_fourcc("ds64")
+	, kJunk = make_riff_fourcc("JUNK")
 	, kFmt = make_riff_fourcc("fmt ")
 	, kData = make_riff_fourcc("data")
 };
@@ -42,70 +51,136 @@ enum eWaveFormatCode : uint16_t
 };
 }
 
+// WAVE_FORMAT_EXTENSIBLE details for layouts beyond stereo.
+constexpr uint16_t kExtensibleSize = 22; // bytes of fmt after m_cbSize
+const uint8_t kSubFormatPcm[16] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+const uint8_t kSubFormatFloat[16] = { 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
 
-inline void decode_16bit_pcm_to_float(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
+// Speaker mask for the usual layout of a channel count: mono, stereo, 5.1 and 7.1.
+uint32_t default_channel_mask(uint16_t channels)
 {
-	constexpr uint32_t kMax = 1 << (16 - 1); // i.e. 2^(bitdepth-1)
-	constexpr float kfCoef = 1.0f / kMax;
-
-	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
-	for (uint32_t i = 0; i < numSamples; i++)
+	switch (channels)
 	{
-		outBuffer[i] = (float)pIn[i] * kfCoef;
+	case 1: return 0x4;		// FC
+	case 2: return 0x3;		// FL FR
+	case 6: return 0x3F;	// FL FR FC LFE BL BR
+	case 8: return 0x63F;	// FL FR FC LFE BL BR SL SR
+	default: return 0;
 	}
 }
 
-//NEW -- 16 bit passthrough
-inline void decode_16bit_pcm_to_16bit(const uint8_t* inBuffer, int16_t* outBuffer, uint32_t numSamples)
+// Interleaved samples write_planar encodes per pass, sized to stay in L1.
+constexpr uint32_t kPlanarChunkSamples = 1024;
+
+// Codecs for each format from the bound table, float needs none.
+DecodeToFloatFunc get_decoder(eAudioFormat format)
 {
-	const int16_t* pIn = reinterpret_cast<const int16_t*>(inBuffer);
-	for (uint32_t i = 0; i < numSamples; i++)
+	switch (format)
 	{
-		outBuffer[i] = pIn[i];
+	case eAudioFormat::kFormat_24bitPCM: return g_pcmCodecs.m_decode24;
+	case eAudioFormat::kFormat_32bitPCM: return g_pcmCodecs.m_decode32;
+	case eAudioFormat::kFormat_32bitFloat: return decode_float_pcm_to_float;
+	default: return g_pcmCodecs.m_decode16;
 	}
 }
 
-inline void encode_float_to_16bit(const float* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+EncodeFromFloatFunc get_encoder(eAudioFormat format)
 {
-	constexpr uint32_t kMax = 1 << (16 - 1); // i.e. 2^(bitdepth-1)
-	constexpr float kfCoef = kMax;
-
-	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
-	for (uint32_t i = 0; i < numSamples; i++)
+	switch (format)
 	{
-		pOut[i] = (uint16_t)(inBuffer[i] * kfCoef);
+	case eAudioFormat::kFormat_24bitPCM: return g_pcmCodecs.m_encode24;
+	case eAudioFormat::kFormat_32bitPCM: return g_pcmCodecs.m_encode32;
+	case eAudioFormat::kFormat_32bitFloat: return encode_float_to_float_pcm;
+	default: return g_pcmCodecs.m_encode16;
 	}
 }
 
-//NEW -- 16 bit passback
-inline void encode_16bit_to_16bit(const int16_t* inBuffer, uint8_t* outBuffer, uint32_t numSamples)
+// Where the chunks a reader needs are, as parse_wave_layout found them.
+struct WaveLayout
+{
+	FmtChunk m_format;
+	uint64_t m_dataStart;
+	uint64_t m_dataSize;
+	bool m_foundFormat;
+	bool m_foundData;
+};
+
+// Walks the chunks of a RIFF, RF64 or BW64 file of fileSize bytes, readAt(offset, dst, bytes)
+// copies bytes out of the file and returns false if it cannot. Chunks of odd size are
+// followed by a pad byte and the fmt chunk can be shorter or longer than FmtChunk.
+template <typename ReadAtFunc>
+WaveLayout parse_wave_layout(ReadAtFunc readAt, uint64_t fileSize)
 {
-	int16_t* pOut = reinterpret_cast<int16_t*>(outBuffer);
-	for (uint32_t i = 0; i < numSamples; i++)
+	ChunkInfo riffChunk;
+	if (!readAt(0, &riffChunk, sizeof(ChunkInfo))
+		|| (riffChunk.m_id != ChunkId::kRiff && riffChunk.m_id != ChunkId::kRf64 && riffChunk.m_id != ChunkId::kBw64))
 	{
-		pOut[i] = inBuffer[i];
+		throw WavAudioFileException("Could not find RIFF chunk.");
 	}
-}
 
-inline void decode_24bit_pcm_to_float(const uint8_t* inBuffer, float* outBuffer, uint32_t numSamples)
-{
-	constexpr float kfDecodeFactor = 1.0f / 0x00EFffffu;
+	WaveChunk waveChunk;
+	if (!readAt(sizeof(ChunkInfo), &waveChunk, sizeof(WaveChunk)) || waveChunk.m_id != ChunkId::kWave)
+	{
+		throw WavAudioFileException("Could not find WAVE chunk.");
+	}
+
+	// the RIFF size is not trusted, the walk goes on to the end of the file.
+	const bool isRf64 = riffChunk.m_id != ChunkId::kRiff;
+	WaveLayout layout = {};
+	Ds64Chunk ds64 = { 0 };
+	uint64_t offset = sizeof(ChunkInfo) + sizeof(WaveChunk);
+	ChunkInfo chunkInfo;
+	while (offset + sizeof(ChunkInfo) <= fileSize && readAt(offset, &chunkInfo, sizeof(ChunkInfo)))
+	{
+		offset += sizeof(ChunkInfo);
+
+		uint64_t chunkSize = chunkInfo.m_size;
+		switch (chunkInfo.m_id)
+		{
+		case ChunkId::kDs64:
+			readAt(offset, &ds64, std::min<uint64_t>(chunkSize, sizeof(Ds64Chunk)));
+			break;
+		case ChunkId::kFmt:
+			// never read past the chunk, any fields it does not cover stay zero.
+			layout.m_format = FmtChunk{ 0 };
+			layout.m_foundFormat = readAt(offset, &layout.m_format, std::min<uint64_t>(chunkSize, sizeof(FmtChunk)));
+			break;
+		case ChunkId::kData:
+			if (isRf64 && chunkSize == kRf64SizeMarker)
+			{
+				chunkSize = ds64.m_dataSize;
+			}
+			// a file cut short keeps whatever audio made it to disk.
+			layout.m_dataStart = offset;
+			layout.m_dataSize = std::min(chunkSize, fileSize - offset);
+			layout.m_foundData = true;
+			break;
+		}
+
+		offset += chunkSize + (chunkSize & 1);
+	}
 
-	const uint8_t* pIn = inBuffer;
-	for (uint32_t i = 0; i < numSamples; i++)
+	if (!layout.m_foundFormat || !layout.m_foundData || layout.m_format.m_bitsPerSample < 8)
 	{
-		int32_t sample = (pIn[2] << 16) | (pIn[1] << 8) | pIn[0];  // < would need to check the order the bytes are packed here. 
-		outBuffer[i] = (float)sample * kfDecodeFactor;
-		pIn += 3;
+		throw WavAudioFileException("Could not find fmt and data chunks.");
 	}
+	return layout;
 }
 
-
 WavAudioFile::WavAudioFile()
-	: m_formatChunk{ 0 }
+	: m_scratchMemory{ nullptr }
+	, m_scratchSize{ 0 }
+	, m_ownsScratchMemory{ false }
+	, m_formatChunk{ 0 }
+	, m_audioFormat{ eAudioFormat::kFormat_16bitPCM }
 	, m_samples{ 0 }
 {}
 
+WavAudioFile::~WavAudioFile()
+{
+	free_scratch_memory();
+}
+
 void WavAudioFile::print_format_info(std::ostream& streamOut) const
 {
 	streamOut
@@ -125,124 +200,327 @@ void WavAudioFile::allocate_scratch_memory(uint32_t size)
 	// check current scratch size.
 	// reallocate if we need to.
 	// otherwise leave as is.
-	if (size > m_scratchMemory.size())
+	if (size > m_scratchSize)
+	{
+		free_scratch_memory();
+		m_scratchMemory = static_cast<uint8_t*>(aligned_malloc(size, kArenaAlignment));
+		m_scratchSize = size;
+		m_ownsScratchMemory = true;
+	}
+}
+
+void WavAudioFile::set_scratch_memory(uint8_t* memory, uint32_t size)
+{
+	free_scratch_memory();
+	m_scratchMemory = memory;
+	m_scratchSize = size;
+	m_ownsScratchMemory = false;
+}
+
+void WavAudioFile::free_scratch_memory()
+{
+	if (m_ownsScratchMemory)
 	{
-		m_scratchMemory.resize(size);
+		aligned_free(m_scratchMemory);
 	}
+	m_scratchMemory = nullptr;
+	m_scratchSize = 0;
+	m_ownsScratchMemory = false;
+}
+
+WavAudioFileInput::WavAudioFileInput(const char* filename, eInputMode mode)
+	: m_mode{ mode }
+	, m_decode{ nullptr }
+	, m_resampling{ false }
+	, m_outputPosition{ 0 }
+{
+	open(filename, mode);
 }
 
-WavAudioFileInput::WavAudioFileInput(const char* filename)
+void WavAudioFileInput::open(const char* filename, eInputMode mode)
 {
-	open(filename);
+	m_mode = mode;
+	m_resampling = false;
+	m_outputPosition = 0;
+	switch (mode)
+	{
+	case eInputMode::kStream: open_stream(filename); break;
+	case eInputMode::kMapped: open_mapped(filename); break;
+	}
+	bind_decoder();
+}
+
+void WavAudioFileInput::bind_decoder()
+{
+	if (!parse_audio_format(m_formatChunk, m_audioFormat))
+	{
+		throw WavAudioFileException("Unsupported sample format.");
+	}
+	m_decode = get_decoder(m_audioFormat);
 }
 
-void WavAudioFileInput::open(const char* filename)
+void WavAudioFileInput::open_stream(const char* filename)
 {
 	m_audioFile.open(filename, std::ios::binary);
-	if (m_audioFile.good())
+	if (!m_audioFile.good())
 	{
+		throw WavAudioFileException("Bad audio file");
+	}
 
-		ChunkInfo riffChunk;
-		m_audioFile.read(reinterpret_cast<char*>(&riffChunk), sizeof(ChunkInfo));
-		if (riffChunk.m_id != ChunkId::kRiff)
-		{
-			throw WavAudioFileException("Could not find RIFF chunk.");
-		}
-		 
-		WaveChunk waveChunk;
-		m_audioFile.read(reinterpret_cast<char*>(&waveChunk), sizeof(WaveChunk));
-		if (waveChunk.m_id != ChunkId::kWave)
+	m_audioFile.seekg(0, std::ios_base::end);
+	const uint64_t fileSize = static_cast<uint64_t>(static_cast<std::streamoff>(m_audioFile.tellg()));
+
+	apply_layout(parse_wave_layout([this](uint64_t offset, void* dst, uint64_t bytes) {
+		m_audioFile.clear();
+		m_audioFile.seekg(static_cast<std::streamoff>(offset), std::ios_base::beg);
+		m_audioFile.read(static_cast<char*>(dst), static_cast<std::streamsize>(bytes));
+		return static_cast<bool>(m_audioFile);
+	}, fileSize));
+
+	// prepare for streaming from the start of the data chunk.
+	m_audioFile.clear();
+	m_audioFile.seekg(static_cast<std::streamoff>(m_dataStart), std::ios_base::beg);
+	ASSERT(m_audioFile);
+}
+
+void WavAudioFileInput::open_mapped(const char* filename)
+{
+	if (!m_mappedFile.open(filename))
+	{
+		throw WavAudioFileException("Bad audio file");
+	}
+
+	// walk the chunks in place, same as the stream parser but without any reads.
+	const uint8_t* const pFile = m_mappedFile.data();
+	const uint64_t fileSize = m_mappedFile.size();
+	apply_layout(parse_wave_layout([pFile, fileSize](uint64_t offset, void* dst, uint64_t bytes) {
+		if (offset + bytes > fileSize)
 		{
-			throw WavAudioFileException("Could not find WAVE chunk.");
+			return false;
 		}
+		memcpy(dst, pFile + offset, static_cast<size_t>(bytes));
+		return true;
+	}, fileSize));
+}
 
-		// Now read the RIFF file chunk by chunk
-		// For 16/24bit audio you only need the '_fmt' chunk and the 'data' chunk 			
+void WavAudioFileInput::apply_layout(const WaveLayout& layout)
+{
+	m_formatChunk = layout.m_format;
+	m_dataStart = layout.m_dataStart;
+	m_dataSize = layout.m_dataSize;
 
-		ChunkInfo chunkInfo;
-		m_audioFile.read(reinterpret_cast<char*>(&chunkInfo), sizeof(ChunkInfo));
-		uint32_t offset = static_cast<uint32_t>(m_audioFile.tellg());
+	const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+	m_samples = m_dataSize / bytesPerSample;
+	m_readPosition = 0;
+}
 
-		while (m_audioFile)
-		{
-			switch (chunkInfo.m_id)
-			{
-			case ChunkId::kFmt: handle_format_chunk(m_audioFile, chunkInfo, offset); break;
-			case ChunkId::kData: handle_data_chunk(m_audioFile, chunkInfo, offset); break;
-			}
+uint64_t WavAudioFileInput::samples_remaining() const
+{
+	if (!m_resampling)
+	{
+		return source_samples_remaining();
+	}
 
-			// seek next and read.
-			m_audioFile.seekg(offset + chunkInfo.m_size, std::ios_base::beg);
-			m_audioFile.read(reinterpret_cast<char*>(&chunkInfo), sizeof(ChunkInfo));
-			offset = static_cast<uint32_t>(m_audioFile.tellg());
-		}
+	const uint32_t channels = get_channels();
+	const uint64_t outputSamples = m_resampler.get_output_frames(m_samples / channels) * channels;
+	return m_outputPosition < outputSamples ? outputSamples - m_outputPosition : 0;
+}
 
-		// May have hit eof during the chunk info parsing.
-		// clear stream state and continue.
-		m_audioFile.clear();
-		ASSERT(m_audioFile);
+uint32_t WavAudioFileInput::source_samples_available(uint32_t numSamples) const
+{
+	return static_cast<uint32_t>(std::min<uint64_t>(numSamples, source_samples_remaining()));
+}
+
+void WavAudioFileInput::seek_sample(uint64_t sample)
+{
+	if (!m_resampling)
+	{
+		seek_source(sample);
+		return;
+	}
+
+	// the resampler restarts with the source frames leading up to the new position.
+	const uint32_t channels = get_channels();
+	m_outputPosition = sample - sample % channels;
+	seek_source(m_resampler.seek(m_outputPosition / channels) * channels);
+}
+
+void WavAudioFileInput::skip(uint32_t numSamples)
+{
+	seek_sample((m_resampling ? m_outputPosition : m_readPosition) + numSamples);
+}
+
+void WavAudioFileInput::enable_resampling(uint32_t outRate, uint32_t maxBlockSamples)
+{
+	const uint32_t inRate = m_formatChunk.m_samplesPerSec;
+	if (inRate == outRate)
+	{
+		m_resampling = false;
+		return;
+	}
+	if (!Resampler::is_ratio_supported(inRate, outRate))
+	{
+		throw WavAudioFileException("Unsupported sample rate conversion.");
+	}
+
+	const uint32_t channels = get_channels();
+	m_resampler.init(inRate, outRate, channels, maxBlockSamples / channels);
+	m_resampleInput.resize(static_cast<size_t>(m_resampler.get_max_input_frames()) * channels);
+	m_resampling = true;
+	seek_sample(0);
+}
 
-		// prepare for streaming
-		// seek to the start of the data chunk.
-		// calculate any remaining samples based on the format info.
-		m_audioFile.seekg(m_dataStart, std::ios_base::beg);
+void WavAudioFileInput::seek_source(uint64_t sample)
+{
+	m_readPosition = std::min(sample, m_samples);
+	if (m_mode == eInputMode::kStream)
+	{
 		const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+		m_audioFile.clear();
+		m_audioFile.seekg(static_cast<std::streamoff>(m_dataStart) + static_cast<std::streamoff>(m_readPosition) * bytesPerSample, std::ios_base::beg);
+	}
+}
 
-		m_samples = m_dataSize / bytesPerSample;
-		m_readPosition = 0;
+const int16_t* WavAudioFileInput::data16() const
+{
+	if (m_mode != eInputMode::kMapped || m_audioFormat != eAudioFormat::kFormat_16bitPCM || m_resampling)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<const int16_t*>(m_mappedFile.data() + m_dataStart);
+}
 
-		ASSERT(m_audioFile);
+const int16_t* WavAudioFileInput::read_view16(uint32_t numSamples)
+{
+	const int16_t* pData = data16();
+	if (pData == nullptr || numSamples > source_samples_remaining())
+	{
+		return nullptr;
 	}
-	else
+
+	const int16_t* pView = pData + m_readPosition;
+	m_readPosition += numSamples;
+	return pView;
+}
+
+const float* WavAudioFileInput::data_float() const
+{
+	if (m_mode != eInputMode::kMapped || m_audioFormat != eAudioFormat::kFormat_32bitFloat || m_resampling)
 	{
-		throw WavAudioFileException("Bad audio file");
+		return nullptr;
 	}
+	return reinterpret_cast<const float*>(m_mappedFile.data() + m_dataStart);
 }
 
-void WavAudioFileInput::read(float* buffer, uint32_t numSamples)
+const float* WavAudioFileInput::read_view(uint32_t numSamples)
 {
-	const uint32_t bytesToRead = numSamples * m_formatChunk.m_bitsPerSample / 8;
-	allocate_scratch_memory(bytesToRead);
+	const float* pData = data_float();
+	if (pData == nullptr || numSamples > source_samples_remaining())
+	{
+		return nullptr;
+	}
 
-	m_audioFile.read((char*)scratch_memory(), bytesToRead);
-	if(m_audioFile)
+	const float* pView = pData + m_readPosition;
+	m_readPosition += numSamples;
+	return pView;
+}
+
+const uint8_t* WavAudioFileInput::data_bytes() const
+{
+	if (m_mode != eInputMode::kMapped)
 	{
-		decode_16bit_pcm_to_float(scratch_memory(), buffer, numSamples);
-		m_readPosition += numSamples;
+		return nullptr;
 	}
+	return m_mappedFile.data() + m_dataStart;
 }
 
-//NEW -- read and pass as 16 bit data
-void WavAudioFileInput::read16(int16_t* buffer, uint32_t numSamples)
+const uint8_t* WavAudioFileInput::mapped_read_pointer() const
 {
-	const uint32_t bytesToRead = numSamples * m_formatChunk.m_bitsPerSample / 8;
-	allocate_scratch_memory(bytesToRead);
+	const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+	return m_mappedFile.data() + m_dataStart + static_cast<size_t>(m_readPosition) * bytesPerSample;
+}
 
-	m_audioFile.read((char*)scratch_memory(), bytesToRead);
-	if (m_audioFile)
+void WavAudioFileInput::read(float* buffer, uint32_t numSamples)
+{
+	TIMER_SCOPED_FINE("read block");
+
+	if (m_resampling)
 	{
-		decode_16bit_pcm_to_16bit(scratch_memory(), buffer, numSamples);
-		m_readPosition += numSamples;
+		read_resampled(buffer, numSamples);
+		return;
 	}
+	read_source(buffer, numSamples);
 }
 
-void WavAudioFileInput::handle_format_chunk(std::ifstream& audioFile, const ChunkInfo& chunkInfo, uint32_t offset)
+void WavAudioFileInput::read_resampled(float* buffer, uint32_t numSamples)
 {
-	UNUSED(offset);
-	UNUSED(chunkInfo);
-	audioFile.read(reinterpret_cast<char*>(&m_formatChunk), sizeof(FmtChunk));
+	const uint32_t channels = get_channels();
+	ASSERT(numSamples % channels == 0);
+	const uint32_t numFrames = numSamples / channels;
+
+	// past the end of the source the filter is fed silence.
+	const uint32_t neededFrames = m_resampler.get_input_frames_needed(numFrames);
+	const uint32_t neededSamples = neededFrames * channels;
+	const uint32_t available = source_samples_available(neededSamples);
+	if (available > 0)
+	{
+		read_source(m_resampleInput.data(), available);
+	}
+	std::fill(m_resampleInput.begin() + available, m_resampleInput.begin() + neededSamples, 0.0f);
+
+	m_resampler.process(m_resampleInput.data(), neededFrames, buffer, numFrames);
+	m_outputPosition += numSamples;
+}
+
+void WavAudioFileInput::read_source(float* buffer, uint32_t numSamples)
+{
+	if (m_mode == eInputMode::kMapped)
+	{
+		// decode directly out of the mapping, no scratch copy.
+		const uint32_t available = source_samples_available(numSamples);
+		m_decode(mapped_read_pointer(), buffer, available);
+		std::fill(buffer + available, buffer + numSamples, 0.0f);
+		m_readPosition += available;
+		return;
+	}
+
+	// never past the data chunk, whatever chunks follow it are not audio.
+	const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+	const uint32_t bytesToRead = source_samples_available(numSamples) * bytesPerSample;
+	allocate_scratch_memory(bytesToRead);
+
+	m_audioFile.read((char*)scratch_memory(), bytesToRead);
+	const uint32_t samplesRead = static_cast<uint32_t>(m_audioFile.gcount()) / bytesPerSample;
+	m_decode(scratch_memory(), buffer, samplesRead);
+	std::fill(buffer + samplesRead, buffer + numSamples, 0.0f);
+	m_readPosition += samplesRead;
 }
 
-void WavAudioFileInput::handle_data_chunk(std::ifstream& audioFile, const ChunkInfo& chunkInfo, uint32_t offset)
+//NEW -- read and pass as 16 bit data
+void WavAudioFileInput::read16(int16_t* buffer, uint32_t numSamples)
 {
-	UNUSED(audioFile);
+	ASSERT(!m_resampling && m_audioFormat == eAudioFormat::kFormat_16bitPCM);
+	if (m_mode == eInputMode::kMapped)
+	{
+		const uint32_t available = source_samples_available(numSamples);
+		decode_16bit_pcm_to_16bit(mapped_read_pointer(), buffer, available);
+		std::fill(buffer + available, buffer + numSamples, int16_t(0));
+		m_readPosition += available;
+		return;
+	}
+
+	const uint32_t bytesToRead = source_samples_available(numSamples) * sizeof(int16_t);
+	allocate_scratch_memory(bytesToRead);
 
-	// can keep reading blocks up until the chunkInfo.m_size
-	m_dataStart = offset;
-	m_dataSize = chunkInfo.m_size;
+	m_audioFile.read((char*)scratch_memory(), bytesToRead);
+	const uint32_t samplesRead = static_cast<uint32_t>(m_audioFile.gcount()) / sizeof(int16_t);
+	decode_16bit_pcm_to_16bit(scratch_memory(), buffer, samplesRead);
+	std::fill(buffer + samplesRead, buffer + numSamples, int16_t(0));
+	m_readPosition += samplesRead;
 }
 
 WavAudioFileOutput::WavAudioFileOutput(const char* filename, FmtChunk format)
+	: m_patching{ false }
 {
 	open(filename, format);
 }
@@ -256,66 +534,244 @@ void WavAudioFileOutput::open(const char* filename, FmtChunk format)
 {
 	std::cout << "Output file: " << filename << "\n";
 
+	m_patching = false;
 	m_formatChunk = format;
+	if (!parse_audio_format(m_formatChunk, m_audioFormat))
+	{
+		throw WavAudioFileException("Unsupported sample format.");
+	}
+	m_encode = get_encoder(m_audioFormat);
+
 	m_audioFile.open(filename, std::ios::binary);
 	if (m_audioFile.good())
 	{
 		m_audioDataSize = 0;
+		m_samples = 0;
 		
 		// write an invalid/dummy header so we can stream audio to the correct location on disk
 		// before closing the file we seek back and re-write the header
 		write_header(); 
+		m_dataStart = static_cast<uint64_t>(static_cast<std::streamoff>(m_audioFile.tellp()));
+	}
+}
+
+void WavAudioFileOutput::open_patch(const char* filename)
+{
+	std::cout << "Patch file: " << filename << "\n";
+
+	// the layout comes from the same chunk walk the reader uses.
+	WaveLayout layout;
+	{
+		std::ifstream audioFile(filename, std::ios::binary);
+		if (!audioFile.good())
+		{
+			throw WavAudioFileException("Bad audio file");
+		}
+		audioFile.seekg(0, std::ios_base::end);
+		const uint64_t fileSize = static_cast<uint64_t>(static_cast<std::streamoff>(audioFile.tellg()));
+		layout = parse_wave_layout([&audioFile](uint64_t offset, void* dst, uint64_t bytes) {
+			audioFile.clear();
+			audioFile.seekg(static_cast<std::streamoff>(offset), std::ios_base::beg);
+			audioFile.read(static_cast<char*>(dst), static_cast<std::streamsize>(bytes));
+			return static_cast<bool>(audioFile);
+		}, fileSize);
+	}
+
+	m_formatChunk = layout.m_format;
+	if (!parse_audio_format(m_formatChunk, m_audioFormat))
+	{
+		throw WavAudioFileException("Unsupported sample format.");
+	}
+	m_encode = get_encoder(m_audioFormat);
+
+	// in and out together open the file without truncating it.
+	m_audioFile.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+	if (!m_audioFile.good())
+	{
+		throw WavAudioFileException("Bad audio file");
+	}
+	m_dataStart = layout.m_dataStart;
+	m_samples = layout.m_dataSize / (m_formatChunk.m_bitsPerSample / 8);
+	m_audioDataSize = m_samples * (m_formatChunk.m_bitsPerSample / 8);
+	m_patching = true;
+}
+
+void WavAudioFileOutput::enable_write_behind(uint32_t batchBytes, uint32_t numBatches)
+{
+	if (m_audioFile.good())
+	{
+		m_writer.start(m_audioFile, batchBytes, numBatches);
+	}
+}
+
+uint8_t* WavAudioFileOutput::begin_write(uint32_t bytes)
+{
+	ASSERT(!m_patching);
+	if (m_writer.is_running())
+	{
+		return m_writer.reserve(bytes);
+	}
+
+	allocate_scratch_memory(bytes);
+	return scratch_memory();
+}
+
+void WavAudioFileOutput::end_write(uint32_t bytes, uint32_t numSamples)
+{
+	if (m_writer.is_running())
+	{
+		m_writer.commit(bytes);
+	}
+	else
+	{
+		m_audioFile.write((const char*)scratch_memory(), bytes);
 	}
+	m_audioDataSize += bytes;
+	m_samples += numSamples;
 }
 
 void WavAudioFileOutput::write(const float* buffer, uint32_t numSamples)
 {
+	TIMER_SCOPED_FINE("write block");
+
 	const uint32_t bytesToWrite = numSamples * m_formatChunk.m_bitsPerSample / 8;
-	allocate_scratch_memory(bytesToWrite);
 
-	encode_float_to_16bit(buffer, scratch_memory(), numSamples);
-	m_audioFile.write((const char*)scratch_memory(), bytesToWrite);
-	m_audioDataSize += bytesToWrite;
-	m_samples += numSamples;
+	m_encode(buffer, begin_write(bytesToWrite), numSamples);
+	end_write(bytesToWrite, numSamples);
+}
+
+void WavAudioFileOutput::write_planar(const float* const* planes, uint32_t numFrames)
+{
+	TIMER_SCOPED_FINE("write planar block");
+
+	const uint32_t numChannels = m_formatChunk.m_channels;
+	const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+	const uint32_t numSamples = numFrames * numChannels;
+	const uint32_t bytesToWrite = numSamples * bytesPerSample;
+	uint8_t* encoded = begin_write(bytesToWrite);
+
+	// interleave a small chunk at a time so it is still in cache when it is encoded.
+	ALIGN16 float interleaved[kPlanarChunkSamples];
+	const uint32_t chunkFrames = std::max(1u, kPlanarChunkSamples / numChannels);
+	const float* chunkPlanes[8];
+	ASSERT(numChannels <= 8 && numChannels <= kPlanarChunkSamples);
+	for (uint32_t frame = 0; frame < numFrames; frame += chunkFrames)
+	{
+		const uint32_t frames = std::min(chunkFrames, numFrames - frame);
+		for (uint32_t c = 0; c < numChannels; ++c)
+		{
+			chunkPlanes[c] = planes[c] + frame;
+		}
+		interleave(chunkPlanes, interleaved, numChannels, frames);
+		m_encode(interleaved, encoded + static_cast<size_t>(frame) * numChannels * bytesPerSample, frames * numChannels);
+	}
+
+	end_write(bytesToWrite, numSamples);
+}
+
+void WavAudioFileOutput::write_silence(uint32_t numSamples)
+{
+	TIMER_SCOPED_FINE("write silence");
+
+	const uint32_t bytesToWrite = numSamples * m_formatChunk.m_bitsPerSample / 8;
+	memset(begin_write(bytesToWrite), 0, bytesToWrite);
+	end_write(bytesToWrite, numSamples);
 }
 
 //NEW -- write as 16 bit
 void WavAudioFileOutput::write16(const int16_t* buffer, uint32_t numSamples)
 {
+	ASSERT(m_audioFormat == eAudioFormat::kFormat_16bitPCM);
 	const uint32_t bytesToWrite = numSamples * m_formatChunk.m_bitsPerSample / 8;
-	allocate_scratch_memory(bytesToWrite);
 
-	encode_16bit_to_16bit(buffer, scratch_memory(), numSamples);
-	m_audioFile.write((const char*)scratch_memory(), bytesToWrite);
-	m_audioDataSize += bytesToWrite;
-	m_samples += numSamples;
+	encode_16bit_to_16bit(buffer, begin_write(bytesToWrite), numSamples);
+	end_write(bytesToWrite, numSamples);
+}
+
+void WavAudioFileOutput::write_at(uint64_t sampleOffset, const float* buffer, uint32_t numSamples, uint8_t* encodeScratch)
+{
+	ASSERT(!m_writer.is_running());
+	ASSERT(!m_patching || sampleOffset + numSamples <= m_samples);
+	const uint32_t bytesPerSample = m_formatChunk.m_bitsPerSample / 8;
+	const uint32_t bytesToWrite = numSamples * bytesPerSample;
+
+	// encode outside the lock, only the file access is serialised.
+	{
+		TIMER_SCOPED_FINE("encode block");
+		m_encode(buffer, encodeScratch, numSamples);
+	}
+
+	TIMER_SCOPED_FINE("write block at");
+	std::lock_guard<std::mutex> lock(m_writeAtMutex);
+	m_audioFile.seekp(static_cast<std::streamoff>(m_dataStart) + static_cast<std::streamoff>(sampleOffset) * bytesPerSample, std::ios_base::beg);
+	m_audioFile.write((const char*)encodeScratch, bytesToWrite);
+
+	m_samples = std::max(m_samples, sampleOffset + numSamples);
+	m_audioDataSize = m_samples * bytesPerSample;
+}
+
+void WavAudioFileOutput::flush()
+{
+	m_writer.flush();
+	m_audioFile.flush();
 }
 
 void WavAudioFileOutput::close()
 {
-	if (m_audioFile.good())
+	// all audio must be on disk before the header describes it.
+	m_writer.stop();
+
+	if (m_audioFile.is_open() && m_audioFile.good() && !m_patching)
 	{
+		// odd sized data is padded to a whole word.
+		if (m_audioDataSize & 1)
+		{
+			m_audioFile.seekp(static_cast<std::streamoff>(m_dataStart + m_audioDataSize), std::ios_base::beg);
+			m_audioFile.put(0);
+		}
+
 		// seek back and re-write the header
 		// write an valid header so we can stream audio to the correct location on disk
 		m_audioFile.seekp(0, std::ios_base::beg);
 		write_header();
 	}
+	if (m_audioFile.is_open())
+	{
+		m_audioFile.close();
+	}
 }
 
 void WavAudioFileOutput::write_header()
 {
-	ChunkInfo riffChunk;
-	riffChunk.m_id = ChunkId::kRiff;
-	riffChunk.m_size = sizeof(WaveChunk)
+	const uint64_t riffSize = sizeof(WaveChunk)
+						+ sizeof(ChunkInfo) + sizeof(Ds64Chunk) // ds64 chunk or the JUNK holding its place
 						+ sizeof(ChunkInfo) + sizeof(FmtChunk) // fmt chunk info and fmt data
-						+ sizeof(ChunkInfo) + m_audioDataSize; // data chunk info and audio data
+						+ sizeof(ChunkInfo) + m_audioDataSize + (m_audioDataSize & 1); // data chunk info, audio data and pad
+	const bool isRf64 = riffSize >= kRf64SizeMarker;
 
+	ChunkInfo riffChunk;
+	riffChunk.m_id = isRf64 ? ChunkId::kRf64 : ChunkId::kRiff;
+	riffChunk.m_size = isRf64 ? kRf64SizeMarker : static_cast<uint32_t>(riffSize);
 	m_audioFile.write(reinterpret_cast<const char*>(&riffChunk), sizeof(ChunkInfo));
 
 	WaveChunk waveChunk;
 	waveChunk.m_id = ChunkId::kWave;
 	m_audioFile.write(reinterpret_cast<const char*>(&waveChunk), sizeof(WaveChunk));
 
+	// readers skip JUNK, so a file that stays under 4GB is plain RIFF.
+	ChunkInfo ds64ChunkInfo;
+	ds64ChunkInfo.m_id = isRf64 ? ChunkId::kDs64 : ChunkId::kJunk;
+	ds64ChunkInfo.m_size = sizeof(Ds64Chunk);
+	Ds64Chunk ds64 = { 0 };
+	if (isRf64)
+	{
+		ds64.m_riffSize = riffSize;
+		ds64.m_dataSize = m_audioDataSize;
+		ds64.m_sampleCount = m_samples / m_formatChunk.m_channels;
+	}
+	m_audioFile.write(reinterpret_cast<const char*>(&ds64ChunkInfo), sizeof(ChunkInfo));
+	m_audioFile.write(reinterpret_cast<const char*>(&ds64), sizeof(Ds64Chunk));
+
 	ChunkInfo fmtChunkInfo;
 	fmtChunkInfo.m_id = ChunkId::kFmt;
 	fmtChunkInfo.m_size = sizeof(FmtChunk);
@@ -324,7 +780,7 @@ void WavAudioFileOutput::write_header()
 
 	ChunkInfo dataChunk;
 	dataChunk.m_id = ChunkId::kData;
-	dataChunk.m_size = m_audioDataSize;
+	dataChunk.m_size = isRf64 ? kRf64SizeMarker : static_cast<uint32_t>(m_audioDataSize);
 	m_audioFile.write(reinterpret_cast<const char*>(&dataChunk), sizeof(ChunkInfo));
 
 }
@@ -335,16 +791,60 @@ WavAudio::FmtChunk make_format(eAudioFormat format, uint16_t channels, uint32_t
 	fmt.m_channels = channels;
 	fmt.m_samplesPerSec = samplerate;
 
+	const bool isFloat = format == eAudioFormat::kFormat_32bitFloat;
 	switch (format)
 	{
-	case eAudioFormat::kFormat_16bitPCM:
-		fmt.m_formatTag = WaveFormatCode::kFormatCode_PCM;
-		fmt.m_bitsPerSample = 16;
-		fmt.m_avgBytesPerSec = samplerate * fmt.m_bitsPerSample / 8 * channels;
-		fmt.m_blockAlign = fmt.m_bitsPerSample / 8 * channels;
-		break;
+	case eAudioFormat::kFormat_16bitPCM: fmt.m_bitsPerSample = 16; break;
+	case eAudioFormat::kFormat_24bitPCM: fmt.m_bitsPerSample = 24; break;
+	case eAudioFormat::kFormat_32bitPCM: fmt.m_bitsPerSample = 32; break;
+	case eAudioFormat::kFormat_32bitFloat: fmt.m_bitsPerSample = 32; break;
+	}
+	fmt.m_formatTag = isFloat ? WaveFormatCode::kFormatCode_Float : WaveFormatCode::kFormatCode_PCM;
+	fmt.m_avgBytesPerSec = samplerate * fmt.m_bitsPerSample / 8 * channels;
+	fmt.m_blockAlign = fmt.m_bitsPerSample / 8 * channels;
+
+	// more than two channels needs the speaker positions, and PCM deeper than 16 bits
+	// should say how many of its bits are valid.
+	if (channels > 2 || (!isFloat && fmt.m_bitsPerSample > 16))
+	{
+		fmt.m_cbSize = kExtensibleSize;
+		fmt.m_validBitsPerSample = fmt.m_bitsPerSample;
+		fmt.m_channelMask = default_channel_mask(channels);
+		memcpy(fmt.m_subFormatGuid, isFloat ? kSubFormatFloat : kSubFormatPcm, sizeof(fmt.m_subFormatGuid));
+		fmt.m_formatTag = WaveFormatCode::kFormatCode_Extensible;
 	}
 	return fmt;
 }
 
+bool parse_audio_format(const FmtChunk& fmt, eAudioFormat& format)
+{
+	// extensible files carry the real format code in the first two bytes of the sub format.
+	uint16_t formatTag = fmt.m_formatTag;
+	if (formatTag == WaveFormatCode::kFormatCode_Extensible)
+	{
+		if (fmt.m_cbSize < kExtensibleSize || memcmp(fmt.m_subFormatGuid + 2, kSubFormatPcm + 2, sizeof(kSubFormatPcm) - 2) != 0)
+		{
+			return false;
+		}
+		formatTag = static_cast<uint16_t>(fmt.m_subFormatGuid[0] | (fmt.m_subFormatGuid[1] << 8));
+	}
+
+	if (formatTag == WaveFormatCode::kFormatCode_Float && fmt.m_bitsPerSample == 32)
+	{
+		format = eAudioFormat::kFormat_32bitFloat;
+		return true;
+	}
+	if (formatTag != WaveFormatCode::kFormatCode_PCM)
+	{
+		return false;
+	}
+	switch (fmt.m_bitsPerSample)
+	{
+	case 16: format = eAudioFormat::kFormat_16bitPCM; return true;
+	case 24: format = eAudioFormat::kFormat_24bitPCM; return true;
+	case 32: format = eAudioFormat::kFormat_32bitPCM; return true;
+	default: return false;
+	}
+}
+
 } // namespace WavAudio
\ No newline at end of file
@@ -4,7 +4,12 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "Config.h"
+#include "MappedFile.h"
+#include "AsyncFileWriter.h"
+#include "PcmCodecs.h"
+#include "Resampler.h"
 #include <fstream>
+#include <mutex>
 #include <vector>
 
 namespace WavAudio {
@@ -13,6 +18,8 @@ namespace WavAudio {
 // http://www-mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
 //////////////////////////////////////////////////////////////////////////////
 
+struct WaveLayout;
+
 #pragma pack(push,1)
 struct ChunkInfo
 {
@@ -28,6 +35,20 @@ struct WaveChunk
 };
 #pragma pack(pop)
 
+#pragma pack(push,1)
+// RF64/BW64 'ds64' chunk, the first chunk after WAVE in files too big for 32 bit RIFF sizes.
+// A RIFF or data size of kRf64SizeMarker means the real size is the one held here.
+struct Ds64Chunk
+{
+	uint64_t m_riffSize;
+	uint64_t m_dataSize;
+	uint64_t m_sampleCount;	// frames, as a fact chunk would count them
+	uint32_t m_tableLength;	// 64 bit sizes of other chunks that follow, never written
+};
+#pragma pack(pop)
+
+constexpr uint32_t kRf64SizeMarker = 0xFFFFFFFF;
+
 #pragma pack(push,1)
 struct FmtChunk
 {
@@ -46,17 +67,31 @@ struct FmtChunk
 
 enum class eAudioFormat
 {
-	kFormat_16bitPCM
+	kFormat_16bitPCM,
+	kFormat_24bitPCM,	// packed, 3 bytes per sample
+	kFormat_32bitPCM,
+	kFormat_32bitFloat	// WAVE_FORMAT_IEEE_FLOAT
 };
 
 FmtChunk make_format(eAudioFormat format, uint16_t channels, uint32_t samplerate);
 
+// Sample encoding of a fmt chunk, plain or WAVE_FORMAT_EXTENSIBLE.
+// Returns false for anything the codecs cannot handle.
+bool parse_audio_format(const FmtChunk& fmt, eAudioFormat& format);
+
+// How an input file gets its sample data.
+enum class eInputMode
+{
+	kStream,	// std::ifstream reads into scratch memory, then decode
+	kMapped		// memory mapped, decode straight from the page cache
+};
+
 // Define an exception type that we throw if parsing the wave file fails.
 class WavAudioFileException : public std::exception
 {
 public:
 	WavAudioFileException(const char* msg) : m_msg(msg) {}
-	virtual char const* what() const override { return m_msg; }
+	virtual char const* what() const noexcept override { return m_msg; }
 private:
 	const char* m_msg;
 };
@@ -64,29 +99,42 @@ private:
 
 // Audio file reading and writing class.
 // Limit support for .wav file format :
-//		Reads : 16bit, mono, PCM
-//		Writes : 16bit, mono, PCM
+//		Reads : 16, 24 and 32bit PCM and 32bit float, any channel count
+//		Writes : the same
+// Plain RIFF, RF64 and BW64 files are read, past 4GB the writer switches to RF64.
+// The codec for the file's format is picked once when it is opened.
 class WavAudioFile
 {
 public:
 	WavAudioFile();
+	~WavAudioFile();
 
 	WavAudioFile(const WavAudioFile&) = delete;
 	WavAudioFile& operator = (const WavAudioFile&) = delete;
 
 	FmtChunk get_format() const { return m_formatChunk; }
-	uint32_t get_samples() const { return m_samples; }
+	uint64_t get_samples() const { return m_samples; }
 	uint32_t get_channels() const { return m_formatChunk.m_channels; }
+	eAudioFormat get_audio_format() const { return m_audioFormat; }
 
 	void print_format_info(std::ostream& streamOut) const;
 
 	void allocate_scratch_memory(uint32_t size);
-	uint8_t* scratch_memory() { return &m_scratchMemory[0]; }
+	uint8_t* scratch_memory() { return m_scratchMemory; }
+
+	// Use externally owned memory as scratch, e.g. from the mixer's aligned arena.
+	// Must outlive the file, a larger request later falls back to an own allocation.
+	void set_scratch_memory(uint8_t* memory, uint32_t size);
 
 protected:
-	std::vector<uint8_t> m_scratchMemory; // decoder memory block, lazy allocation as we need it.
+	void free_scratch_memory();
+
+	uint8_t* m_scratchMemory; // decoder memory block, 64 byte aligned, lazy allocation as we need it.
+	uint32_t m_scratchSize;	// size of m_scratchMemory in bytes.
+	bool m_ownsScratchMemory; // false when set_scratch_memory provided it.
 	FmtChunk m_formatChunk; // hold the format information
-	uint32_t m_samples;		// number of samples in the data block.
+	eAudioFormat m_audioFormat; // sample encoding parsed from m_formatChunk
+	uint64_t m_samples;		// number of samples in the data block.
 };
 
 
@@ -94,32 +142,98 @@ class WavAudioFileInput : public WavAudioFile
 {
 public:
 	// inherit default constructor
-	WavAudioFileInput(){}
+	WavAudioFileInput() : m_mode{ eInputMode::kStream }, m_decode{ nullptr }, m_resampling{ false }, m_outputPosition{ 0 } {}
 
 	// construct and open for reading
-	WavAudioFileInput(const char* filename);
+	WavAudioFileInput(const char* filename, eInputMode mode = eInputMode::kStream);
 
-	void open(const char* filename);
+	void open(const char* filename, eInputMode mode = eInputMode::kStream);
 
 	// Read samples, samples are converted to floating point but the channel data remains interleaved.
+	// In mapped mode samples past the end of the data are returned as silence.
+	// Float files are copied as they are, without scaling or clamping.
 	void read(float* buffer, uint32_t numSamples);
 
-	uint32_t samples_remaining() const { return m_samples - m_readPosition; }
+	// Samples read() can still return, at the output rate when resampling.
+	uint64_t samples_remaining() const;
+
+	// Moves the read position to an absolute sample index, clamped to the end of the data.
+	// When resampling the index is at the output rate.
+	void seek_sample(uint64_t sample);
+
+	// seek_sample to the start of a frame.
+	void seek(uint64_t frame) { seek_sample(frame * get_channels()); }
 
-	//custom 16 bit functions
+	// Moves the read position on by numSamples without decoding them.
+	void skip(uint32_t numSamples);
+
+	// Converts everything read() returns from the file's rate to outRate, for blocks of up to
+	// maxBlockSamples. Does nothing if the rates already match, throws if the ratio is not
+	// supported. Call right after open(), the 16 bit reads do not resample.
+	void enable_resampling(uint32_t outRate, uint32_t maxBlockSamples);
+
+	bool is_resampling() const { return m_resampling; }
+
+	//custom 16 bit functions, 16 bit PCM files only
 	void read16(int16_t * buffer, uint32_t numSamples);
 
+	eInputMode get_mode() const { return m_mode; }
+
+	// Mapped mode only, nullptr otherwise.
+	// The whole data chunk as 16 bit samples, valid until the file is closed.
+	const int16_t* data16() const;
+
+	// Mapped mode only, zero copy passthrough of the next numSamples 16 bit samples.
+	// Advances the read position, returns nullptr if not mapped or fewer samples remain.
+	const int16_t* read_view16(uint32_t numSamples);
+
+	// The same for 32 bit float files, which the mixer can use without any decode.
+	const float* data_float() const;
+	const float* read_view(uint32_t numSamples);
+
+	// Mapped mode only, the data chunk's bytes in the file's own encoding, for hashing.
+	const uint8_t* data_bytes() const;
+	uint64_t get_data_size() const { return m_dataSize; }
+
 private:
 
-	void handle_format_chunk(std::ifstream& audioFile, const ChunkInfo& chunkInfo, uint32_t offset);
+	void open_stream(const char* filename);
+
+	void open_mapped(const char* filename);
+
+	// Takes the format and data position from a parsed chunk layout.
+	void apply_layout(const WaveLayout& layout);
+
+	// Mapped data at the current read position.
+	const uint8_t* mapped_read_pointer() const;
+
+	// Reads and seeks at the file's own rate.
+	uint64_t source_samples_remaining() const { return m_samples - m_readPosition; }
+	void read_source(float* buffer, uint32_t numSamples);
+	void seek_source(uint64_t sample);
+
+	// Up to numSamples, fewer if the data ends first.
+	uint32_t source_samples_available(uint32_t numSamples) const;
+
+	// read() through the resampler.
+	void read_resampled(float* buffer, uint32_t numSamples);
 
-	void handle_data_chunk(std::ifstream& audioFile, const ChunkInfo& chunkInfo, uint32_t offset);
+	// Checks the parsed format and binds its decoder.
+	void bind_decoder();
 
 private:
+	eInputMode m_mode;
 	std::ifstream m_audioFile; // file stream
-	uint32_t m_dataStart; // start position of audio data in bytes
-	uint32_t m_dataSize; // size of audio data in bytes
-	uint32_t m_readPosition; // read position in samples
+	MappedFile m_mappedFile; // mapped view of the file
+	uint64_t m_dataStart; // start position of audio data in bytes
+	uint64_t m_dataSize; // size of audio data in bytes
+	uint64_t m_readPosition; // read position in samples
+	DecodeToFloatFunc m_decode; // for m_audioFormat, bound at open
+
+	bool m_resampling; // read() converts to the resampler's output rate
+	Resampler m_resampler;
+	std::vector<float> m_resampleInput; // decoded source frames for one resampled block
+	uint64_t m_outputPosition; // read position in output rate samples when resampling
 };
 
 
@@ -127,7 +241,7 @@ private:
 class WavAudioFileOutput : public WavAudioFile
 {
 public:
-	WavAudioFileOutput() {}
+	WavAudioFileOutput() : m_encode{ nullptr }, m_patching{ false } {}
 
 	// construct and open for writing with specified format.
 	WavAudioFileOutput(const char* filename, FmtChunk format);
@@ -136,20 +250,61 @@ public:
 
 	void open(const char* filename, FmtChunk format);
 
+	// Opens an existing file to overwrite parts of its audio with write_at, keeping its
+	// format, length and every other chunk. Writes must stay inside the data and close()
+	// leaves the header alone.
+	void open_patch(const char* filename);
+
+	// Switches to write behind: blocks are encoded into batchBytes sized batches
+	// and a background thread writes each full batch in one call.
+	// Call after open(), stays on until close().
+	void enable_write_behind(uint32_t batchBytes, uint32_t numBatches);
+
 	// Read samples, samples are converted to floating point but the channel data is interleaved.
 	void write(const float* buffer, uint32_t numSamples);
 
+	// Writes numFrames frames from one plane per channel, interleaving them as they are encoded.
+	void write_planar(const float* const* planes, uint32_t numFrames);
+
+	// Waits until everything written so far has reached the stream.
+	void flush();
+
+	// Encodes numSamples into encodeScratch and writes them at an absolute sample offset
+	// in the data chunk, extending the file as needed. Safe to call from several threads
+	// as long as each passes its own encodeScratch, but not mixed with write() or write behind.
+	void write_at(uint64_t sampleOffset, const float* buffer, uint32_t numSamples, uint8_t* encodeScratch);
+
+	// Drains any write behind queue, rewrites the header in place and closes the file.
+	// Data past 4GB turns the file into RF64, using the space the header reserved for it.
 	void close();
 
-	//custom 16 bit functions
+	// Writes numSamples of silence, zero bytes in every format so nothing is encoded.
+	void write_silence(uint32_t numSamples);
+
+	//custom 16 bit functions, 16 bit PCM files only
 	void write16(const int16_t * buffer, uint32_t numSamples);
 
+	// Number of times a write had to wait for the write behind thread.
+	uint32_t get_write_stall_count() const { return m_writer.get_stall_count(); }
+
 private:
 
+	// Destination for the next bytes of encoded audio, the write behind batch or scratch memory.
+	uint8_t* begin_write(uint32_t bytes);
+
+	// Hands bytes from begin_write to the writer.
+	void end_write(uint32_t bytes, uint32_t numSamples);
+
+	// The header is the same size for RIFF and RF64, a JUNK chunk holds the place of ds64.
 	void write_header();
 
 	std::ofstream m_audioFile; // file stream
-	uint32_t m_audioDataSize; // size of audio data in bytes
+	AsyncFileWriter m_writer; // write behind queue, only running when enabled
+	std::mutex m_writeAtMutex; // serialises seek + write in write_at
+	uint64_t m_dataStart; // start position of audio data in bytes
+	uint64_t m_audioDataSize; // size of audio data in bytes
+	EncodeFromFloatFunc m_encode; // for m_audioFormat, bound at open
+	bool m_patching; // opened with open_patch, the header already describes the data
 };
 
 } // namespace WavAudio
@@ -0,0 +1,192 @@
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "WorkStealingPool.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+
+// Idle workers poll this many times before going to sleep, batches arrive once per block
+// so a short spin saves a wake up on the next one.
+constexpr uint32_t kIdleSpins = 256;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool()
+	: m_numQueues{ 1 }
+	, m_remaining{ 0 }
+	, m_queued{ 0 }
+	, m_stopRequested{ false }
+	, m_stealCount{ 0 }
+{
+	m_queues.reset(new TaskQueue[m_numQueues]);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	stop();
+}
+
+void WorkStealingPool::start(uint32_t numWorkers)
+{
+	stop();
+
+	if (numWorkers == 0)
+	{
+		numWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	m_numQueues = numWorkers + 1;
+	m_queues.reset(new TaskQueue[m_numQueues]);
+	m_queued.store(0, std::memory_order_relaxed);
+	m_stopRequested = false;
+	m_stealCount.store(0, std::memory_order_relaxed);
+
+	m_workers.reserve(numWorkers);
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		m_workers.emplace_back(&WorkStealingPool::worker_thread, this, i);
+	}
+}
+
+void WorkStealingPool::stop()
+{
+	if (m_workers.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopRequested = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	m_numQueues = 1;
+	m_queues.reset(new TaskQueue[m_numQueues]);
+}
+
+void WorkStealingPool::run(TaskFunc func, void* context, uint32_t count)
+{
+	// nothing to share, skip the queues.
+	if (count <= 1 || m_workers.empty())
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			func(context, i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+	m_remaining.store(count, std::memory_order_relaxed);
+
+	// deal the tasks out round robin so each thread starts on its own share.
+	for (uint32_t q = 0; q < m_numQueues; ++q)
+	{
+		std::lock_guard<std::mutex> lock(m_queues[q].m_mutex);
+		for (uint32_t i = q; i < count; i += m_numQueues)
+		{
+			m_queues[q].m_tasks.push_back({ func, context, i });
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_queued.fetch_add(static_cast<int32_t>(count), std::memory_order_release);
+	}
+	m_wake.notify_all();
+
+	// help out until the whole batch is done, not just our own share.
+	const uint32_t callerQueue = m_numQueues - 1;
+	Task task;
+	while (m_remaining.load(std::memory_order_acquire) != 0)
+	{
+		if (pop_task(callerQueue, task) || steal_task(callerQueue, task))
+		{
+			execute(task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void WorkStealingPool::worker_thread(uint32_t queue)
+{
+	TIMER_THREAD_NAME("mix pool");
+
+	Task task;
+	uint32_t idleSpins = 0;
+	for (;;)
+	{
+		if (pop_task(queue, task) || steal_task(queue, task))
+		{
+			execute(task);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < kIdleSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]() { return m_stopRequested || m_queued.load(std::memory_order_acquire) > 0; });
+		if (m_stopRequested)
+		{
+			return;
+		}
+		idleSpins = 0;
+	}
+}
+
+bool WorkStealingPool::pop_task(uint32_t queue, Task& task)
+{
+	TaskQueue& own = m_queues[queue];
+	std::lock_guard<std::mutex> lock(own.m_mutex);
+	if (own.m_tasks.empty())
+	{
+		return false;
+	}
+
+	task = own.m_tasks.back();
+	own.m_tasks.pop_back();
+	m_queued.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool WorkStealingPool::steal_task(uint32_t queue, Task& task)
+{
+	// start with the next queue along so thieves spread over their victims.
+	for (uint32_t i = 1; i < m_numQueues; ++i)
+	{
+		TaskQueue& victim = m_queues[(queue + i) % m_numQueues];
+		std::lock_guard<std::mutex> lock(victim.m_mutex);
+		if (!victim.m_tasks.empty())
+		{
+			task = victim.m_tasks.front();
+			victim.m_tasks.pop_front();
+			m_queued.fetch_sub(1, std::memory_order_relaxed);
+			m_stealCount.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::execute(const Task& task)
+{
+	task.m_func(task.m_context, task.m_index);
+	m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
@@ -0,0 +1,82 @@
+#pragma once
+//////////////////////////////////////////////////////////////////////////
+// Audio Mixing Prototype (Optimization Assignment)
+//////////////////////////////////////////////////////////////////////////
+
+#include "Config.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for short fork/join batches.
+// run() spreads a batch of indexed tasks over per thread queues, each thread pops its
+// own queue from the back and steals from the front of the others once it runs dry.
+// The calling thread works on the batch too and returns once every task has finished.
+//
+//		pool.run(task_func, &context, numTasks);	// task_func(&context, 0..numTasks-1)
+class WorkStealingPool
+{
+public:
+	typedef void (*TaskFunc)(void* context, uint32_t index);
+
+	WorkStealingPool();
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator = (const WorkStealingPool&) = delete;
+
+	// Starts numWorkers threads besides the caller, 0 uses one per remaining hardware thread.
+	void start(uint32_t numWorkers);
+
+	// Joins the workers, run() then executes everything on the caller.
+	void stop();
+
+	// Runs func(context, i) for every i in [0, count). Only one batch runs at a time
+	// and tasks must not call run() themselves.
+	void run(TaskFunc func, void* context, uint32_t count);
+
+	uint32_t get_num_workers() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	// Number of tasks a thread took from another thread's queue.
+	uint64_t get_steal_count() const { return m_stealCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Task
+	{
+		TaskFunc m_func;
+		void* m_context;
+		uint32_t m_index;
+	};
+
+	// One per thread, padded so neighbouring locks do not share a cache line.
+	struct TaskQueue
+	{
+		std::mutex m_mutex;
+		std::deque<Task> m_tasks;
+		uint8_t m_pad[64];
+	};
+
+	void worker_thread(uint32_t queue);
+
+	bool pop_task(uint32_t queue, Task& task);
+	bool steal_task(uint32_t queue, Task& task);
+	void execute(const Task& task);
+
+	std::vector<std::thread> m_workers;
+	std::unique_ptr<TaskQueue[]> m_queues;	// one per worker, the caller's queue is last
+	uint32_t m_numQueues;
+
+	std::mutex m_runMutex;	// one batch at a time
+	std::atomic<uint32_t> m_remaining;	// tasks of the current batch not yet finished
+	std::atomic<int32_t> m_queued;	// tasks sitting in any queue
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	bool m_stopRequested;
+
+	std::atomic<uint64_t> m_stealCount;
+};